@@ -6,10 +6,10 @@ LDFLAGS = -lpcre -lpthread
 
 .PHONY : all clean
 
-all : libtable.a libtable.so table_stack table_col_adder table_test table_reg_test
+all : libtable.a libtable.so table table_stack table_col_adder table_test table_reg_test
 
 clean :
-	rm -f *.o libtable.a libtable.so* table_stack table_col_adder table_test table_reg_test
+	rm -f *.o libtable.a libtable.so* table table_stack table_col_adder table_test table_reg_test
 
 % : %.o
 	$(CXX) $+ $(LDFLAGS) -o $@
@@ -24,6 +24,7 @@ clean :
 #objects
 table.o : table.h
 table_fPIC.o : table.h
+table_main.o : table.h
 table_stack.o : table.h
 table_split.o : table.h
 table_col_adder.o : table.h
@@ -46,6 +47,9 @@ libtable.so : libtable.so.$(TABLE_MAJOR_VER)
 
 
 #binaries
+table : table_main.o libtable.a
+	$(CXX) $+ $(LDFLAGS) -o $@
+
 table_stack : libtable.a
 table_split : libtable.a
 table_col_adder : libtable.a
@@ -67,11 +67,207 @@ static void strreverse(char* begin, char* end)
     while (end > begin) aux = *end, *end-- = *begin, *begin++ = aux;
 }
 
+//shortest round trip formatting is Grisu2 (Loitsch, "Printing floating-point numbers quickly and accurately with integers").
+//it always reads back as the same double and is the shortest such text for all but a tiny fraction of values
+
+struct diy_fp_t
+{
+  uint64_t f;
+  int e;
+
+  diy_fp_t(uint64_t f, int e) : f(f), e(e) {}
+  diy_fp_t operator-(const diy_fp_t& rhs) const { return diy_fp_t(f - rhs.f, e); }
+  diy_fp_t operator*(const diy_fp_t& rhs) const {
+    const uint64_t m32 = 0xFFFFFFFF;
+    const uint64_t a = f >> 32, b = f & m32, c = rhs.f >> 32, d = rhs.f & m32;
+    const uint64_t ac = a * c, bc = b * c, ad = a * d, bd = b * d;
+    uint64_t tmp = (bd >> 32) + (ad & m32) + (bc & m32);
+    tmp += uint64_t(1) << 31; // round
+    return diy_fp_t(ac + (ad >> 32) + (bc >> 32) + (tmp >> 32), e + rhs.e + 64);
+  }
+};
+
+static const uint64_t dp_hidden_bit = 0x0010000000000000ULL;
+static const int dp_significand_size = 52;
+
+static const uint64_t cached_powers_f[] = {
+  0xfa8fd5a0081c0288ULL, 0xbaaee17fa23ebf76ULL, 0x8b16fb203055ac76ULL, 0xcf42894a5dce35eaULL,
+  0x9a6bb0aa55653b2dULL, 0xe61acf033d1a45dfULL, 0xab70fe17c79ac6caULL, 0xff77b1fcbebcdc4fULL,
+  0xbe5691ef416bd60cULL, 0x8dd01fad907ffc3cULL, 0xd3515c2831559a83ULL, 0x9d71ac8fada6c9b5ULL,
+  0xea9c227723ee8bcbULL, 0xaecc49914078536dULL, 0x823c12795db6ce57ULL, 0xc21094364dfb5637ULL,
+  0x9096ea6f3848984fULL, 0xd77485cb25823ac7ULL, 0xa086cfcd97bf97f4ULL, 0xef340a98172aace5ULL,
+  0xb23867fb2a35b28eULL, 0x84c8d4dfd2c63f3bULL, 0xc5dd44271ad3cdbaULL, 0x936b9fcebb25c996ULL,
+  0xdbac6c247d62a584ULL, 0xa3ab66580d5fdaf6ULL, 0xf3e2f893dec3f126ULL, 0xb5b5ada8aaff80b8ULL,
+  0x87625f056c7c4a8bULL, 0xc9bcff6034c13053ULL, 0x964e858c91ba2655ULL, 0xdff9772470297ebdULL,
+  0xa6dfbd9fb8e5b88fULL, 0xf8a95fcf88747d94ULL, 0xb94470938fa89bcfULL, 0x8a08f0f8bf0f156bULL,
+  0xcdb02555653131b6ULL, 0x993fe2c6d07b7facULL, 0xe45c10c42a2b3b06ULL, 0xaa242499697392d3ULL,
+  0xfd87b5f28300ca0eULL, 0xbce5086492111aebULL, 0x8cbccc096f5088ccULL, 0xd1b71758e219652cULL,
+  0x9c40000000000000ULL, 0xe8d4a51000000000ULL, 0xad78ebc5ac620000ULL, 0x813f3978f8940984ULL,
+  0xc097ce7bc90715b3ULL, 0x8f7e32ce7bea5c70ULL, 0xd5d238a4abe98068ULL, 0x9f4f2726179a2245ULL,
+  0xed63a231d4c4fb27ULL, 0xb0de65388cc8ada8ULL, 0x83c7088e1aab65dbULL, 0xc45d1df942711d9aULL,
+  0x924d692ca61be758ULL, 0xda01ee641a708deaULL, 0xa26da3999aef774aULL, 0xf209787bb47d6b85ULL,
+  0xb454e4a179dd1877ULL, 0x865b86925b9bc5c2ULL, 0xc83553c5c8965d3dULL, 0x952ab45cfa97a0b3ULL,
+  0xde469fbd99a05fe3ULL, 0xa59bc234db398c25ULL, 0xf6c69a72a3989f5cULL, 0xb7dcbf5354e9beceULL,
+  0x88fcf317f22241e2ULL, 0xcc20ce9bd35c78a5ULL, 0x98165af37b2153dfULL, 0xe2a0b5dc971f303aULL,
+  0xa8d9d1535ce3b396ULL, 0xfb9b7cd9a4a7443cULL, 0xbb764c4ca7a44410ULL, 0x8bab8eefb6409c1aULL,
+  0xd01fef10a657842cULL, 0x9b10a4e5e9913129ULL, 0xe7109bfba19c0c9dULL, 0xac2820d9623bf429ULL,
+  0x80444b5e7aa7cf85ULL, 0xbf21e44003acdd2dULL, 0x8e679c2f5e44ff8fULL, 0xd433179d9c8cb841ULL,
+  0x9e19db92b4e31ba9ULL, 0xeb96bf6ebadf77d9ULL, 0xaf87023b9bf0ee6bULL
+};
+
+static const int16_t cached_powers_e[] = {
+  -1220, -1193, -1166, -1140, -1113, -1087, -1060, -1034, -1007, -980,
+  -954, -927, -901, -874, -847, -821, -794, -768, -741, -715,
+  -688, -661, -635, -608, -582, -555, -529, -502, -475, -449,
+  -422, -396, -369, -343, -316, -289, -263, -236, -210, -183,
+  -157, -130, -103, -77, -50, -24, 3, 30, 56, 83,
+  109, 136, 162, 189, 216, 242, 269, 295, 322, 348,
+  375, 402, 428, 455, 481, 508, 534, 561, 588, 614,
+  641, 667, 694, 720, 747, 774, 800, 827, 853, 880,
+  907, 933, 960, 986, 1013, 1039, 1066
+};
+
+static diy_fp_t normalize(diy_fp_t v, int top_bit)
+{
+  while(!(v.f & (dp_hidden_bit << top_bit))) { v.f <<= 1; v.e--; }
+  v.f <<= 64 - dp_significand_size - 1 - top_bit;
+  v.e -= 64 - dp_significand_size - 1 - top_bit;
+  return v;
+}
+
+static void grisu_round(char* buf, int len, uint64_t delta, uint64_t rest, uint64_t ten_kappa, uint64_t wp_w)
+{
+  while(rest < wp_w && delta - rest >= ten_kappa && (rest + ten_kappa < wp_w || wp_w - rest > rest + ten_kappa - wp_w)) {
+    buf[len - 1]--;
+    rest += ten_kappa;
+  }
+}
+
+static void digit_gen(const diy_fp_t& w, const diy_fp_t& mp, uint64_t delta, char* buf, int& len, int& k)
+{
+  static const uint64_t pow10_64[] = {
+    1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL, 100000000ULL, 1000000000ULL,
+    10000000000ULL, 100000000000ULL, 1000000000000ULL, 10000000000000ULL, 100000000000000ULL, 1000000000000000ULL,
+    10000000000000000ULL, 100000000000000000ULL, 1000000000000000000ULL, 10000000000000000000ULL
+  };
+  const diy_fp_t one(uint64_t(1) << -mp.e, mp.e);
+  const diy_fp_t wp_w = mp - w;
+  uint32_t p1 = uint32_t(mp.f >> -one.e);
+  uint64_t p2 = mp.f & (one.f - 1);
+  int kappa = 1;
+  while(kappa < 10 && p1 >= pow10_64[kappa]) ++kappa;
+  len = 0;
+
+  while(kappa > 0) {
+    const uint32_t div = uint32_t(pow10_64[kappa - 1]);
+    const uint32_t d = p1 / div;
+    p1 %= div;
+    if(d || len) buf[len++] = char('0' + d);
+    kappa--;
+    const uint64_t tmp = (uint64_t(p1) << -one.e) + p2;
+    if(tmp <= delta) {
+      k += kappa;
+      grisu_round(buf, len, delta, tmp, pow10_64[kappa] << -one.e, wp_w.f);
+      return;
+    }
+  }
+
+  while(1) {
+    p2 *= 10;
+    delta *= 10;
+    const char d = char(p2 >> -one.e);
+    if(d || len) buf[len++] = char('0' + d);
+    p2 &= one.f - 1;
+    kappa--;
+    if(p2 < delta) {
+      k += kappa;
+      grisu_round(buf, len, delta, p2, one.f, wp_w.f * (-kappa < 20 ? pow10_64[-kappa] : 0));
+      return;
+    }
+  }
+}
+
+static void grisu2(double value, char* buf, int& len, int& k)
+{
+  union { double d; uint64_t u; } bits;
+  bits.d = value;
+  const int biased_e = int((bits.u & 0x7FF0000000000000ULL) >> dp_significand_size);
+  const uint64_t significand = bits.u & 0x000FFFFFFFFFFFFFULL;
+  const int bias = 0x3FF + dp_significand_size;
+  const diy_fp_t v = biased_e ? diy_fp_t(significand + dp_hidden_bit, biased_e - bias) : diy_fp_t(significand, 1 - bias);
+
+  //boundaries halfway to the neighboring doubles
+  const diy_fp_t plus = normalize(diy_fp_t((v.f << 1) + 1, v.e - 1), 1);
+  diy_fp_t minus = (v.f == dp_hidden_bit) ? diy_fp_t((v.f << 2) - 1, v.e - 2) : diy_fp_t((v.f << 1) - 1, v.e - 1);
+  minus.f <<= minus.e - plus.e;
+  minus.e = plus.e;
+
+  //cached 10^-k that brings plus.e into [-60, -32]
+  const double dk = (-61 - plus.e) * 0.30102999566398114 + 347;
+  int ki = int(dk);
+  if(dk - ki > 0.0) ++ki;
+  const unsigned index = unsigned((ki >> 3) + 1);
+  k = -(-348 + int(index << 3));
+  const diy_fp_t c_mk(cached_powers_f[index], cached_powers_e[index]);
+
+  const diy_fp_t w = normalize(v, 0) * c_mk;
+  diy_fp_t wp = plus * c_mk;
+  diy_fp_t wm = minus * c_mk;
+  wm.f++;
+  wp.f--;
+  digit_gen(w, wp, wp.f - wm.f, buf, len, k);
+}
+
+int dtostr(double value, char* str)
+{
+  if(isnan(value)) { str[0] = '\0'; return 0; }
+
+  char* p = str;
+  if(value < 0) { *p++ = '-'; value = -value; }
+  if(value == 0) { p = str; *p++ = '0'; *p = '\0'; return p - str; }
+  if(isinf(value)) { memcpy(p, "inf", 4); return p + 3 - str; }
+
+  char digits[24];
+  int len, k;
+  grisu2(value, digits, len, k);
+
+  //value is digits * 10^k, written out in full when the decimal point is near the digits and in exponent form otherwise
+  const int point = len + k;
+  if(k >= 0 && point <= 21) {
+    memcpy(p, digits, len); p += len;
+    for(int i = 0; i < k; ++i) *p++ = '0';
+  }
+  else if(point > 0 && point <= 21) {
+    memcpy(p, digits, point); p += point;
+    *p++ = '.';
+    memcpy(p, digits + point, len - point); p += len - point;
+  }
+  else if(point > -6 && point <= 0) {
+    *p++ = '0'; *p++ = '.';
+    for(int i = point; i < 0; ++i) *p++ = '0';
+    memcpy(p, digits, len); p += len;
+  }
+  else {
+    *p++ = digits[0];
+    if(len > 1) { *p++ = '.'; memcpy(p, digits + 1, len - 1); p += len - 1; }
+    int exp = point - 1;
+    *p++ = 'e';
+    if(exp < 0) { *p++ = '-'; exp = -exp; }
+    else *p++ = '+';
+    if(exp >= 100) { *p++ = char('0' + exp / 100); exp %= 100; *p++ = char('0' + exp / 10); }
+    else *p++ = char('0' + exp / 10);
+    *p++ = char('0' + exp % 10);
+  }
+  *p = '\0';
+
+  return p - str;
+}
+
 int dtostr(double value, char* str, int prec)
 {
   if(isnan(value)) { str[0] = '\0'; return 0; }
-  const double thres = (double)(0x7FFFFFFF);
-  if(value > thres || value < -thres) { return sprintf(str, "%.6g", value); }
+  //past 10^15 there are no fractional digits left to round, so the shortest form is as precise as it gets
+  if(value >= 1e15 || value <= -1e15) { return dtostr(value, str); }
 
   // precision of >= 10 can lead to overflow errors
   if (prec < 0) { prec = 0; }
@@ -79,7 +275,7 @@ int dtostr(double value, char* str, int prec)
 
   bool neg = 0;
   if(value < 0) { neg = 1; value = -value; }
-  int whole = (int)value;
+  uint64_t whole = (uint64_t)value;
   double tmp = (value - whole) * pow10[prec];
   uint32_t frac = (uint32_t)(tmp);
   double diff = tmp - frac;
@@ -109,6 +305,34 @@ int dtostr(double value, char* str, int prec)
   return wstr - str;
 }
 
+bool parse_number(const char* token, size_t len, double& value)
+{
+  char buf[64];
+  if(!len || len >= sizeof(buf)) return 0;
+  for(size_t i = 0; i < len; ++i) {
+    const char c = token[i];
+    if(!((c >= '0' && c <= '9') || c == '.' || c == '-' || c == '+' || c == 'e' || c == 'E')) return 0;
+    buf[i] = c;
+  }
+  buf[len] = '\0';
+  char* end;
+  value = strtod(buf, &end);
+  return end == buf + len;
+}
+
+int itostr(int64_t value, char* str)
+{
+  //the magnitude goes through uint64_t so the most negative value doesn't overflow
+  char* wstr = str;
+  uint64_t mag = value < 0 ? 0 - uint64_t(value) : uint64_t(value);
+  do { *wstr++ = '0' + char(mag % 10); } while(mag /= 10);
+  if(value < 0) *wstr++ = '-';
+  *wstr = '\0';
+  strreverse(str, wstr-1);
+
+  return wstr - str;
+}
+
 static float gammln(float xx)
 {
   const double cof[6] = {
@@ -174,6 +398,428 @@ float ibeta(float a, float b, float x)
   else return 1.0f - bt * betacf(b, a, 1.0f - x) / b;
 }
 
+const char* csv_parallel_scanner_t::chunk_begin(size_t chunk)
+{
+  if(!chunk) return begin;
+  if(chunk >= num_chunks) return end;
+  const char* p = static_cast<const char*>(memchr(begin + chunk * chunk_size - 1, '\n', end - (begin + chunk * chunk_size - 1)));
+  return p ? p + 1 : end;
+}
+
+void* csv_parallel_scanner_t::worker_main(void* data)
+{
+  worker_t& w = *static_cast<worker_t*>(data);
+  csv_parallel_scanner_t& s = *w.s;
+
+  for(size_t c = w.id; c < s.num_chunks; c += s.workers.size()) {
+    pthread_mutex_lock(&s.mutex);
+    while(!s.abort && c >= s.consumed + s.chunks.size()) pthread_cond_wait(&s.cond, &s.mutex);
+    bool abort = s.abort;
+    pthread_mutex_unlock(&s.mutex);
+    if(abort) break;
+
+    chunk_t& ch = s.chunks[c % s.chunks.size()];
+    ch.begin = s.chunk_begin(c);
+    ch.end = s.chunk_begin(c + 1);
+    s.parse(s.context, ch);
+
+    pthread_mutex_lock(&s.mutex);
+    ch.ready = c + 1;
+    pthread_cond_broadcast(&s.cond);
+    pthread_mutex_unlock(&s.mutex);
+  }
+
+  return 0;
+}
+
+void csv_parallel_scanner_t::start(const char* begin, const char* end, size_t threads, size_t chunk_size, parse_t parse, const void* context)
+{
+  stop();
+  this->parse = parse;
+  this->context = context;
+  this->begin = begin;
+  this->end = end;
+  this->chunk_size = chunk_size;
+  num_chunks = (end - begin + chunk_size - 1) / chunk_size;
+  if(threads > num_chunks) threads = num_chunks;
+  consumed = 0;
+  have_current = 0;
+  abort = 0;
+  chunks.resize(threads * 2);
+  for(vector<chunk_t>::iterator i = chunks.begin(); i != chunks.end(); ++i) (*i).ready = 0;
+
+  pthread_mutex_init(&mutex, 0);
+  pthread_cond_init(&cond, 0);
+  workers.resize(threads);
+  for(size_t i = 0; i < threads; ++i) {
+    workers[i].s = this;
+    workers[i].id = i;
+    if(pthread_create(&workers[i].thread, 0, worker_main, &workers[i])) { workers.resize(i); stop(); throw runtime_error("can't create csv scanner thread"); }
+  }
+}
+
+const csv_parallel_scanner_t::chunk_t* csv_parallel_scanner_t::next()
+{
+  if(workers.empty()) return 0;
+
+  pthread_mutex_lock(&mutex);
+  if(have_current) { ++consumed; pthread_cond_broadcast(&cond); }
+  have_current = 0;
+  if(consumed >= num_chunks) { pthread_mutex_unlock(&mutex); return 0; }
+  chunk_t& ch = chunks[consumed % chunks.size()];
+  while(ch.ready != consumed + 1) pthread_cond_wait(&cond, &mutex);
+  have_current = 1;
+  pthread_mutex_unlock(&mutex);
+
+  return &ch;
+}
+
+void csv_parallel_scanner_t::stop()
+{
+  if(workers.empty()) return;
+
+  pthread_mutex_lock(&mutex);
+  abort = 1;
+  pthread_cond_broadcast(&cond);
+  pthread_mutex_unlock(&mutex);
+  for(vector<worker_t>::iterator i = workers.begin(); i != workers.end(); ++i) pthread_join((*i).thread, 0);
+  workers.clear();
+  pthread_cond_destroy(&cond);
+  pthread_mutex_destroy(&mutex);
+}
+
+#ifdef TABLE_ZSTD
+void zstd_file_reader_t::open(const char* path)
+{
+  f.open(path);
+  if(!ds && !(ds = ZSTD_createDStream())) throw runtime_error("can't create zstd stream");
+  if(ZSTD_isError(ZSTD_initDStream(ds))) throw runtime_error("can't init zstd stream");
+  if(!in_buf) { in_cap = ZSTD_DStreamInSize(); in_buf = new char[in_cap]; }
+  in.src = in_buf; in.size = 0; in.pos = 0;
+  frame_left = 0;
+  in_eof = 0;
+}
+
+ssize_t zstd_file_reader_t::read(void* buf, size_t len)
+{
+  ZSTD_outBuffer out = { buf, len, 0 };
+  while(!out.pos) {
+    if(in.pos == in.size && !in_eof) { in.size = f.read(in_buf, in_cap); in.pos = 0; in_eof = !in.size; }
+    if(in.pos == in.size && in_eof && !frame_left) break;
+
+    //with no input left the stream can still flush what it holds, if it can't the last frame was cut short
+    const size_t out_pos = out.pos;
+    frame_left = ZSTD_decompressStream(ds, &out, &in);
+    if(ZSTD_isError(frame_left)) throw runtime_error(string("couldn't decompress: ") + ZSTD_getErrorName(frame_left));
+    if(in_eof && in.pos == in.size && out.pos == out_pos && frame_left) throw runtime_error("couldn't decompress: truncated input");
+  }
+  return out.pos;
+}
+
+void zstd_file_writer_t::open(const char* path)
+{
+  if(is_open) close();
+  f.open(path);
+  if(!cs && !(cs = ZSTD_createCStream())) throw runtime_error("can't create zstd stream");
+  if(ZSTD_isError(ZSTD_initCStream(cs, level))) throw runtime_error("can't init zstd stream");
+  if(!out_buf) { out_cap = ZSTD_CStreamOutSize(); out_buf = new char[out_cap]; }
+  is_open = 1;
+}
+
+void zstd_file_writer_t::compress(ZSTD_inBuffer& in, ZSTD_EndDirective mode)
+{
+  while(1) {
+    ZSTD_outBuffer out = { out_buf, out_cap, 0 };
+    const size_t left = ZSTD_compressStream2(cs, &out, &in, mode);
+    if(ZSTD_isError(left)) throw runtime_error(string("couldn't compress: ") + ZSTD_getErrorName(left));
+    if(out.pos) f.write(out_buf, out.pos);
+    if(mode == ZSTD_e_end ? !left : in.pos == in.size) break;
+  }
+}
+
+void zstd_file_writer_t::write(const void* buf, size_t len, bool silent)
+{
+  ZSTD_inBuffer in = { buf, len, 0 };
+  try { compress(in, ZSTD_e_continue); }
+  catch(...) { if(!silent) throw; }
+}
+
+void zstd_file_writer_t::close()
+{
+  if(!is_open) return;
+  is_open = 0;
+  ZSTD_inBuffer in = { 0, 0, 0 };
+  compress(in, ZSTD_e_end);
+  f.close();
+}
+#endif
+
+char compress_block(const vector<char>& in, vector<char>& out)
+{
+  if(in.size() < 64) return BC_NONE;
+#if defined(TABLE_ZSTD)
+  out.resize(ZSTD_compressBound(in.size()));
+  const size_t len = ZSTD_compress(&out[0], out.size(), &in[0], in.size(), 3);
+  if(ZSTD_isError(len) || len >= in.size()) return BC_NONE;
+  out.resize(len);
+  return BC_ZSTD;
+#elif defined(TABLE_ZLIB)
+  uLongf len = compressBound(uLong(in.size()));
+  out.resize(len);
+  if(compress2(reinterpret_cast<Bytef*>(&out[0]), &len, reinterpret_cast<const Bytef*>(&in[0]), uLong(in.size()), 6) != Z_OK || len >= in.size()) return BC_NONE;
+  out.resize(len);
+  return BC_ZLIB;
+#else
+  return BC_NONE;
+#endif
+}
+
+void decompress_block(char codec, const char* in, size_t len, char* out, size_t raw_len)
+{
+  if(codec == BC_NONE) {
+    if(len != raw_len) throw runtime_error("invalid columnar block");
+    memcpy(out, in, len);
+  }
+#ifdef TABLE_ZLIB
+  else if(codec == BC_ZLIB) {
+    uLongf out_len = uLong(raw_len);
+    if(uncompress(reinterpret_cast<Bytef*>(out), &out_len, reinterpret_cast<const Bytef*>(in), uLong(len)) != Z_OK || out_len != raw_len) throw runtime_error("couldn't decompress columnar block");
+  }
+#endif
+#ifdef TABLE_ZSTD
+  else if(codec == BC_ZSTD) {
+    const size_t out_len = ZSTD_decompress(out, raw_len, in, len);
+    if(ZSTD_isError(out_len) || out_len != raw_len) throw runtime_error("couldn't decompress columnar block");
+  }
+#endif
+  else {
+    stringstream msg; msg << "columnar block codec " << int(codec) << " isn't built in";
+    throw runtime_error(msg.str());
+  }
+}
+
+//builds a flatbuffer front to back, a table's children are always written after it so every uoffset points forward
+class flatbuffer_builder_t
+{
+public:
+  struct field_t { int id; int size; uint64_t value; }; //size 0 is an offset to fill in with set_offset
+
+  vector<char> buf;
+
+  void pad(size_t align) { while(buf.size() % align) buf.push_back(0); }
+  template<typename T> size_t put(T value) { pad(sizeof(T)); const size_t at = buf.size(); buf.insert(buf.end(), reinterpret_cast<const char*>(&value), reinterpret_cast<const char*>(&value) + sizeof(T)); return at; }
+  void set_offset(size_t at, size_t target) { const uint32_t offset = uint32_t(target - at); memcpy(&buf[at], &offset, sizeof(offset)); }
+  size_t add_string(const string& s) { const size_t at = put(uint32_t(s.size())); buf.insert(buf.end(), s.begin(), s.end()); buf.push_back(0); return at; }
+  size_t add_offset_vector(size_t count, vector<size_t>& elems) { const size_t at = put(uint32_t(count)); elems.clear(); for(size_t i = 0; i < count; ++i) elems.push_back(put(uint32_t(0))); return at; }
+  size_t add_struct_vector(const vector<int64_t>& longs, size_t longs_per_struct) {
+    while((buf.size() + 4) % 8) buf.push_back(0);
+    const size_t at = put(uint32_t(longs.size() / longs_per_struct));
+    for(vector<int64_t>::const_iterator i = longs.begin(); i != longs.end(); ++i) put(*i);
+    return at;
+  }
+  size_t add_table(const field_t* fields, size_t num_fields, size_t* offsets_at);
+};
+
+size_t flatbuffer_builder_t::add_table(const field_t* fields, size_t num_fields, size_t* offsets_at)
+{
+  //the table starts 8 byte aligned, so laying fields out aligned from its start aligns them in the buffer
+  vector<uint16_t> field_offsets(num_fields);
+  size_t inline_size = 4;
+  int max_id = -1;
+  for(size_t f = 0; f < num_fields; ++f) {
+    const size_t size = fields[f].size ? fields[f].size : 4;
+    inline_size = (inline_size + size - 1) / size * size;
+    field_offsets[f] = uint16_t(inline_size);
+    inline_size += size;
+    max_id = max(max_id, fields[f].id);
+  }
+
+  const size_t vtable = put(uint16_t(4 + 2 * (max_id + 1)));
+  put(uint16_t(inline_size));
+  for(int id = 0; id <= max_id; ++id) {
+    uint16_t offset = 0;
+    for(size_t f = 0; f < num_fields; ++f) if(fields[f].id == id) offset = field_offsets[f];
+    put(offset);
+  }
+
+  pad(8);
+  const size_t table = buf.size();
+  put(int32_t(table - vtable));
+  for(size_t f = 0; f < num_fields; ++f) {
+    while(buf.size() < table + field_offsets[f]) buf.push_back(0);
+    if(!fields[f].size) *offsets_at++ = put(uint32_t(0));
+    else buf.insert(buf.end(), reinterpret_cast<const char*>(&fields[f].value), reinterpret_cast<const char*>(&fields[f].value) + fields[f].size);
+  }
+  while(buf.size() < table + inline_size) buf.push_back(0);
+  return table;
+}
+
+//Message { version: MetadataVersion V5, header_type, header, bodyLength }, framed by the continuation marker and the metadata length
+static size_t arrow_message(flatbuffer_builder_t& fb, uint8_t header_type, size_t body_len)
+{
+  const size_t root = fb.put(uint32_t(0));
+  const flatbuffer_builder_t::field_t fields[] = { { 0, 2, 4 }, { 1, 1, header_type }, { 2, 0, 0 }, { 3, 8, body_len } };
+  size_t header_at;
+  fb.set_offset(root, fb.add_table(fields, 4, &header_at));
+  return header_at;
+}
+
+static void arrow_frame(const flatbuffer_builder_t& fb, vector<char>& msg)
+{
+  msg.assign(8, '\xff');
+  const int32_t len = int32_t((fb.buf.size() + 7) & ~size_t(7));
+  memcpy(&msg[4], &len, sizeof(len));
+  msg.insert(msg.end(), fb.buf.begin(), fb.buf.end());
+  msg.resize(8 + len, 0);
+}
+
+void arrow_schema_message(const vector<string>& names, const vector<char>& is_double, vector<char>& msg)
+{
+  flatbuffer_builder_t fb;
+  const size_t header_at = arrow_message(fb, 1, 0);
+
+  //Schema { endianness: Little, fields }
+  const flatbuffer_builder_t::field_t schema_fields[] = { { 0, 2, 0 }, { 1, 0, 0 } };
+  size_t fields_at;
+  fb.set_offset(header_at, fb.add_table(schema_fields, 2, &fields_at));
+  vector<size_t> elems;
+  fb.set_offset(fields_at, fb.add_offset_vector(names.size(), elems));
+
+  //Field { name, nullable, type_type: FloatingPoint or Utf8, type, children }
+  for(size_t i = 0; i < names.size(); ++i) {
+    const flatbuffer_builder_t::field_t field_fields[] = { { 0, 0, 0 }, { 1, 1, 1 }, { 2, 1, uint64_t(is_double[i] ? 3 : 5) }, { 3, 0, 0 }, { 5, 0, 0 } };
+    size_t at[3];
+    fb.set_offset(elems[i], fb.add_table(field_fields, 5, at));
+    fb.set_offset(at[0], fb.add_string(names[i]));
+    const flatbuffer_builder_t::field_t precision[] = { { 0, 2, 2 } }; //DOUBLE
+    fb.set_offset(at[1], fb.add_table(precision, is_double[i] ? 1 : 0, 0));
+    vector<size_t> no_children;
+    fb.set_offset(at[2], fb.add_offset_vector(0, no_children));
+  }
+
+  arrow_frame(fb, msg);
+}
+
+void arrow_record_batch_message(size_t rows, const vector<int64_t>& nodes, const vector<int64_t>& buffers, size_t body_len, vector<char>& msg)
+{
+  flatbuffer_builder_t fb;
+  const size_t header_at = arrow_message(fb, 3, body_len);
+
+  //RecordBatch { length, nodes: [FieldNode], buffers: [Buffer] }
+  const flatbuffer_builder_t::field_t batch_fields[] = { { 0, 8, rows }, { 1, 0, 0 }, { 2, 0, 0 } };
+  size_t at[2];
+  fb.set_offset(header_at, fb.add_table(batch_fields, 3, at));
+  fb.set_offset(at[0], fb.add_struct_vector(nodes, 2));
+  fb.set_offset(at[1], fb.add_struct_vector(buffers, 2));
+
+  arrow_frame(fb, msg);
+}
+
+void multi_file_reader_t::add_glob(const char* pattern)
+{
+#ifdef _WIN32
+  WIN32_FIND_DATA fd;
+  HANDLE h = FindFirstFile(pattern, &fd);
+  if(h == INVALID_HANDLE_VALUE) throw runtime_error(string("no files match ") + pattern);
+  string dir(pattern);
+  const size_t slash = dir.find_last_of("\\/");
+  dir = (slash == string::npos) ? string() : dir.substr(0, slash + 1);
+  vector<string> found;
+  do { if(!(fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) found.push_back(dir + fd.cFileName); } while(FindNextFile(h, &fd));
+  FindClose(h);
+  sort(found.begin(), found.end());
+  paths.insert(paths.end(), found.begin(), found.end());
+#else
+  glob_t g;
+  const int rc = glob(pattern, 0, 0, &g);
+  if(rc == GLOB_NOMATCH) throw runtime_error(string("no files match ") + pattern);
+  else if(rc) throw runtime_error(string("can't glob ") + pattern);
+  for(size_t i = 0; i < g.gl_pathc; ++i) paths.push_back(g.gl_pathv[i]);
+  globfree(&g);
+#endif
+}
+
+bool multi_file_reader_t::split_header(size_t begin, bool eof, size_t& end, vector<string>& file_keys) const
+{
+  //the header ends at the first '\n' outside quotes, a '\r' before it is part of the line end
+  file_keys.assign(1, string());
+  bool quoted = 0;
+  for(size_t i = begin; i < pending.size(); ++i) {
+    const char c = pending[i];
+    if(quoted) {
+      if(c != quote) file_keys.back() += c;
+      else if(i + 1 == pending.size() && !eof) return 0; //might be an escaped quote
+      else if(i + 1 < pending.size() && pending[i + 1] == quote) { file_keys.back() += c; ++i; }
+      else quoted = 0;
+    }
+    else if(quote && c == quote) quoted = 1;
+    else if(c == delim) file_keys.push_back(string());
+    else if(c == '\n') {
+      if(i > begin && pending[i - 1] == '\r') file_keys.back().erase(file_keys.back().size() - 1);
+      end = i;
+      return 1;
+    }
+    else file_keys.back() += c;
+  }
+  if(!eof) return 0;
+  if(!file_keys.back().empty() && pending[pending.size() - 1] == '\r') file_keys.back().erase(file_keys.back().size() - 1);
+  end = pending.size();
+  return 1;
+}
+
+void multi_file_reader_t::open_next()
+{
+  const string& path = paths[next_path++];
+  f.open(path.c_str());
+  file_open = 1;
+  last = '\n';
+
+  //read up to the end of the header, which is the first non blank line
+  pending.clear();
+  pending_off = 0;
+  size_t begin = 0;
+  size_t end = 0;
+  bool eof = 0;
+  vector<string> file_keys;
+  char chunk[4096];
+  while(1) {
+    begin = pending.find_first_not_of('\n');
+    if(begin != string::npos && split_header(begin, eof, end, file_keys)) break;
+    if(eof) return; //an empty file
+    ssize_t num_read = f.read(chunk, sizeof(chunk));
+    if(!num_read) eof = 1;
+    pending.append(chunk, num_read);
+  }
+
+  if(!have_header) { keys = file_keys; header_path = path; have_header = 1; }
+  else if(file_keys != keys) throw runtime_error("header of " + path + " doesn't match " + header_path);
+  else pending_off = end;
+}
+
+ssize_t multi_file_reader_t::read(void* buf, size_t len)
+{
+  while(1) {
+    if(!file_open) {
+      if(next_path >= paths.size()) return 0;
+      open_next();
+    }
+
+    ssize_t num_read;
+    if(pending_off < pending.size()) {
+      num_read = min(len, pending.size() - pending_off);
+      memcpy(buf, pending.data() + pending_off, num_read);
+      pending_off += num_read;
+    }
+    else num_read = f.read(buf, len);
+
+    if(num_read) { last = static_cast<char*>(buf)[num_read - 1]; return num_read; }
+
+    f.close();
+    file_open = 0;
+    if(last != '\n') { *static_cast<char*>(buf) = '\n'; last = '\n'; return 1; } //keep the last line of a file from running into the next
+  }
+}
+
 void arg_fetcher::get_next()
 {
   while(1) {
@@ -388,4 +1034,156 @@ void arg_fetcher::get_next()
 bool always_split_arg(int type, const char* key, size_t len) { return 1; }
 
 
+////////////////////////////////////////////////////////////////////////////////////////////////
+// pass_chain
+////////////////////////////////////////////////////////////////////////////////////////////////
+
+enum summarize_mode_e { SM_NONE = 0, SM_GROUP = -1, SM_PRE_SORTED_GROUP = -2, SM_EXCEPTION = -3 };
+
+pass_chain_t::~pass_chain_t()
+{
+  for(vector<stage_t>::iterator i = stages.begin(); i != stages.end(); ++i) delete (*i).in;
+}
+
+template<typename pass_t> pass_t* pass_chain_t::add_stage(stage_e type)
+{
+  pass_t* p = new pass_t;
+  stage_t s; s.type = type; s.in = p; s.out = p;
+  stages.push_back(s);
+  return p;
+}
+
+bool pass_chain_t::add_setting(arg_fetcher& af)
+{
+  if(linked) throw runtime_error("pass_chain can't take settings after link");
+
+  const int type = af.type();
+  if(type & st_ddash) {
+    if(!af.key()) return 0;
+    const string key(af.key(), af.key_len());
+    if(!add_args.empty()) throw runtime_error("add needs a column regex, new column, from and to for each column");
+
+    if(key == "stack") { add_stage<dynamic_output_dynamic_stacker>(SG_STACK)->set_default_action(ST_LEAVE); mode = ST_STACK; }
+    else if(key == "split") { add_stage<dynamic_output_dynamic_splitter>(SG_SPLIT); mode = SP_SPLIT; }
+    else if(key == "sort") { add_stage<dynamic_output_dynamic_sorter>(SG_SORT); mode = 1; }
+    else if(key == "summarize") { add_stage<dynamic_output_dynamic_summarizer>(SG_SUMMARIZE); mode = SM_NONE; }
+    else if(key == "add") add_stage<dynamic_output_dynamic_substitute_col_adder>(SG_ADD);
+    else if(key == "prune") add_stage<dynamic_output_dynamic_col_pruner>(SG_PRUNE);
+    else if(key == "thread") add_stage<dynamic_output_dynamic_threader>(SG_THREAD);
+    else return 0;
+    regex = 0; remove_source = 0; option_used = 0;
+    if(type & st_val) add_value(af.val());
+    return 1;
+  }
+
+  if(stages.empty()) return 0;
+  if(type & st_dash) {
+    if(!af.key()) return 0;
+    add_option(string(af.key(), af.key_len()));
+    if(type & st_val) add_value(af.val());
+    return 1;
+  }
+  if((type & st_plus) || !(type & st_val)) return 0;
+  add_value(af.val());
+  return 1;
+}
+
+void pass_chain_t::add_option(const string& option)
+{
+  const stage_e type = stages.back().type;
+  const char c = option.size() == 1 ? option[0] : '\0';
+  if(type == SG_STACK) {
+    if(c == 's' || c == 'S') mode = ST_STACK;
+    else if(c == 'r' || c == 'R') mode = ST_REMOVE;
+    else if(c == 'l' || c == 'L') mode = ST_LEAVE;
+    else throw runtime_error("invalid stack option: -" + option);
+    regex = c < 'a';
+  }
+  else if(type == SG_SPLIT) {
+    if(c == 'g' || c == 'G') mode = SP_GROUP;
+    else if(c == 'b' || c == 'B') mode = SP_SPLIT_BY;
+    else if(c == 's' || c == 'S') mode = SP_SPLIT;
+    else if(c == 'r' || c == 'R') mode = SP_REMOVE;
+    else throw runtime_error("invalid split option: -" + option);
+    regex = c < 'a';
+  }
+  else if(type == SG_SORT) {
+    if(c == 'a') mode = 1;
+    else if(c == 'd') mode = 0;
+    else throw runtime_error("invalid sort option: -" + option);
+  }
+  else if(type == SG_SUMMARIZE) {
+    //statistics named one after the other all apply to the columns that follow them
+    int flag = 0;
+    if(option == "g") mode = SM_GROUP;
+    else if(option == "p") mode = SM_PRE_SORTED_GROUP;
+    else if(option == "e") mode = SM_EXCEPTION;
+    else if(option == "missing") flag = SUM_MISSING;
+    else if(option == "count") flag = SUM_COUNT;
+    else if(option == "sum") flag = SUM_SUM;
+    else if(option == "min") flag = SUM_MIN;
+    else if(option == "max") flag = SUM_MAX;
+    else if(option == "avg") flag = SUM_AVG;
+    else if(option == "var") flag = SUM_VARIANCE;
+    else if(option == "std") flag = SUM_STD_DEV;
+    else throw runtime_error("invalid summarize option: -" + option);
+    if(flag) mode = (mode > 0 && !option_used) ? (mode | flag) : flag;
+  }
+  else if(type == SG_ADD) {
+    if(c == 'r') remove_source = 1;
+    else if(c == 'k') remove_source = 0;
+    else throw runtime_error("invalid add option: -" + option);
+  }
+  else throw runtime_error("stage takes no options: -" + option);
+  option_used = 0;
+}
+
+void pass_chain_t::add_value(const char* val)
+{
+  stage_t& s = stages.back();
+  option_used = 1;
+  if(s.type == SG_STACK) static_cast<dynamic_output_dynamic_stacker*>(s.in)->add_action(regex, val, stack_action_e(mode));
+  else if(s.type == SG_SPLIT) static_cast<dynamic_output_dynamic_splitter*>(s.in)->add_action(regex, val, split_action_e(mode));
+  else if(s.type == SG_SORT) static_cast<dynamic_output_dynamic_sorter*>(s.in)->add_sort(val, mode);
+  else if(s.type == SG_SUMMARIZE) {
+    dynamic_output_dynamic_summarizer* p = static_cast<dynamic_output_dynamic_summarizer*>(s.in);
+    if(mode == SM_GROUP) p->add_group(val);
+    else if(mode == SM_PRE_SORTED_GROUP) p->add_group(val, 1);
+    else if(mode == SM_EXCEPTION) p->add_exception(val);
+    else if(mode > 0) p->add_data(val, mode);
+    else throw runtime_error("summarize needs -g, -p, -e or a statistic before " + string(val));
+  }
+  else if(s.type == SG_ADD) {
+    add_args.push_back(val);
+    if(add_args.size() == 4) {
+      substituter sub(add_args[2].c_str(), add_args[3].c_str());
+      static_cast<dynamic_output_dynamic_substitute_col_adder*>(s.in)->add(add_args[0].c_str(), add_args[1].c_str(), sub, remove_source);
+      add_args.clear();
+    }
+  }
+  else throw runtime_error("stage takes no values: " + string(val));
+}
+
+dynamic_pass_t* pass_chain_t::link(dynamic_pass_t* out)
+{
+  if(linked) throw runtime_error("pass_chain is already linked");
+  if(!add_args.empty()) throw runtime_error("add needs a column regex, new column, from and to for each column");
+
+  if(thread_stages) {
+    vector<stage_t> unthreaded; unthreaded.swap(stages);
+    for(vector<stage_t>::iterator i = unthreaded.begin(); i != unthreaded.end(); ++i) {
+      if(!stages.empty() && stages.back().type != SG_THREAD && (*i).type != SG_THREAD) add_stage<dynamic_output_dynamic_threader>(SG_THREAD);
+      stages.push_back(*i);
+    }
+  }
+
+  for(vector<stage_t>::reverse_iterator i = stages.rbegin(); i != stages.rend(); ++i) {
+    (*i).out->set_out(out);
+    out = (*i).in;
+  }
+  linked = 1;
+  return out;
+}
+
+
 }
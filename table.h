@@ -26,6 +26,21 @@
 #include <errno.h>
 #ifdef _WIN32
 #include <windows.h>
+#else
+#include <sys/mman.h>
+#include <glob.h>
+#endif
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#ifdef TABLE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef TABLE_ZSTD
+#include <zstd.h>
 #endif
 
 #ifndef O_BINARY
@@ -48,7 +63,10 @@ int minor_ver();
 
 extern void resize_buffer(char*& buf, char*& next, char*& end, size_t min_to_add = 0, char** resize_end = 0);
 extern void generate_substitution(const char* token, const char* replace_with, const int* ovector, int num_captured, char*& buf, char*& next, char*& end);
-extern int dtostr(double value, char* str, int prec = 6);
+extern int dtostr(double value, char* str); //shortest text that reads back as the same double
+extern int dtostr(double value, char* str, int prec); //rounded to prec decimal places, at most 9
+extern bool parse_number(const char* token, size_t len, double& value); //plain decimal and exponent forms only, so hex, inf, nan and padded text aren't numbers
+extern int itostr(int64_t value, char* str); //at most 20 characters
 extern float ibeta(float a, float b, float x);
 
 struct cstr_less {
@@ -163,18 +181,82 @@ extern bool always_split_arg(int type, const char* key, size_t len);
 // pass
 ////////////////////////////////////////////////////////////////////////////////////////////////
 
-class empty_pass_t {};
+//a reader calls get_skip_columns after the process_key calls and before process_keys, a pass that returns columns to skip gets no
+//process_token calls for them, asking again gives the same answer
+//process_token(int64_t) falls back to process_token(double) and process_null to an empty token for a pass that doesn't have them
+//process_block carries a run of process_token, process_null and process_line calls, token i is tokens[i] for lens[i] bytes or
+//when tokens[i] is 0 a value of kind lens[i] % 4 from values or ints at lens[i] / 4, line_ends holds the token count at the end
+//of each line and tokens after the last one carry on into the next block
+class row_block_t {
+public:
+  enum kind_e { BK_DOUBLE, BK_INT, BK_NULL };
+
+  vector<const char*> tokens;
+  vector<size_t> lens;
+  vector<size_t> line_ends;
+  vector<double> values;
+  vector<int64_t> ints;
+
+  void clear() { tokens.clear(); lens.clear(); line_ends.clear(); values.clear(); ints.clear(); }
+  bool empty() const { return tokens.empty() && line_ends.empty(); }
+  size_t lines() const { return line_ends.size(); }
+  void add_token(const char* token, size_t len) { tokens.push_back(token); lens.push_back(len); }
+  void add_token(double token) { tokens.push_back(0); lens.push_back(values.size() * 4 + BK_DOUBLE); values.push_back(token); }
+  void add_token(int64_t token) { tokens.push_back(0); lens.push_back(ints.size() * 4 + BK_INT); ints.push_back(token); }
+  void add_null() { tokens.push_back(0); lens.push_back(BK_NULL); }
+  void add_line() { line_ends.push_back(tokens.size()); }
+  template<typename pass_t> void replay(pass_t& out) const; //the per token calls the block stands for
+};
+
+template<typename pass_t> class has_process_null_t { //value is 1 if pass_t has a process_null of its own or inherited
+  struct fallback_t { void process_null(); };
+  struct derived_t : pass_t, fallback_t {};
+  template<typename T, T> struct check_t;
+  template<typename U> static char (&test(check_t<void (fallback_t::*)(), &U::process_null>*))[1];
+  template<typename U> static char (&test(...))[2];
+
+public:
+  enum { value = sizeof(test<derived_t>(0)) == 2 };
+};
+
+template<bool native> struct null_caller_t { template<typename pass_t> static void call(pass_t& out) { out.process_null(); } };
+template<> struct null_caller_t<false> { template<typename pass_t> static void call(pass_t& out) { out.process_token("", 0); } };
+template<typename pass_t> inline void pass_null(pass_t& out) { null_caller_t<has_process_null_t<pass_t>::value>::call(out); }
+
+//buffers that mark doubles, nulls and the like with a byte below '\x10' put a '\x0f' in front of a string token starting with one
+inline size_t string_tag_len(const char* token, size_t len) { return len && static_cast<unsigned char>(*token) < 0x10; }
+
+template<typename pass_t> class direct_pass_t { //calls pass_t's own members, so a block replayed into a dynamic pass skips the virtual calls
+  pass_t& p;
+
+public:
+  direct_pass_t(pass_t& p) : p(p) {}
+  void process_token(const char* token, size_t len) { p.pass_t::process_token(token, len); }
+  void process_token(double token) { p.pass_t::process_token(token); }
+  void process_token(int64_t token) { p.pass_t::process_token(token); }
+  void process_null() { p.pass_t::process_null(); }
+  void process_line() { p.pass_t::process_line(); }
+};
+
+class empty_pass_t {
+public:
+  const vector<bool>* get_skip_columns() { return 0; }
+};
 
 class dynamic_pass_t {
 public:
   virtual ~dynamic_pass_t() {}
+  virtual const vector<bool>* get_skip_columns() { return 0; }
   virtual void reinit(int more_passes = 0) = 0;
   virtual void reinit_state(int more_passes = 0) = 0;
   virtual void process_key(const char* token, size_t len) = 0;
   virtual void process_keys() = 0;
   virtual void process_token(const char* token, size_t len) = 0;
   virtual void process_token(double token) = 0;
+  virtual void process_token(int64_t token) { process_token(double(token)); }
+  virtual void process_null() { process_token("", 0); }
   virtual void process_line() = 0;
+  virtual void process_block(const row_block_t& block) { block.replay(*this); }
   virtual void process_stream() = 0;
 };
 
@@ -187,13 +269,19 @@ template<typename out_t> class single_output_pass_class_t {
 protected:
   out_t out;
 
+  enum { block_output = 0 }; //a static out inlines the per token calls, so blocks only pay off across a dynamic_pass_t
+
   void reinit_output_if(int more_passes = 0) { if(more_passes > 0) out.reinit(--more_passes); else if(more_passes < 0) out.reinit(more_passes); }
   void reinit_output_state_if(int more_passes = 0) { if(more_passes > 0) out.reinit_state(--more_passes); else if(more_passes < 0) out.reinit_state(more_passes); }
   void output_key(const char* token, size_t len) { out.process_key(token, len); }
   void output_keys() { out.process_keys(); }
+  const vector<bool>* output_skip_columns() { return out.get_skip_columns(); }
   void output_token(const char* token, size_t len) { out.process_token(token, len); }
   void output_token(double token) { out.process_token(token); }
+  void output_token(int64_t token) { out.process_token(token); }
+  void output_null() { pass_null(out); }
   void output_line() { out.process_line(); }
+  void output_block(const row_block_t& block) { block.replay(out); }
   void output_stream() { out.process_stream(); }
 
 public:
@@ -204,13 +292,19 @@ template<> class single_output_pass_class_t<dynamic_pass_t*> {
 protected:
   dynamic_pass_t* out;
 
+  enum { block_output = 1 };
+
   void reinit_output_if(int more_passes = 0) { if(more_passes > 0) out->reinit(--more_passes); else if(more_passes < 0) out->reinit(more_passes); }
   void reinit_output_state_if(int more_passes = 0) { if(more_passes > 0) out->reinit_state(--more_passes); else if(more_passes < 0) out->reinit_state(more_passes); }
   void output_key(const char* token, size_t len) { out->process_key(token, len); }
   void output_keys() { out->process_keys(); }
+  const vector<bool>* output_skip_columns() { return out->get_skip_columns(); }
   void output_token(const char* token, size_t len) { out->process_token(token, len); }
   void output_token(double token) { out->process_token(token); }
+  void output_token(int64_t token) { out->process_token(token); }
+  void output_null() { out->process_null(); }
   void output_line() { out->process_line(); }
+  void output_block(const row_block_t& block) { out->process_block(block); }
   void output_stream() { out->process_stream(); }
 
 public:
@@ -234,6 +328,7 @@ public:
   virtual void write(char c) = 0;
   virtual void write(const char* token, size_t len) = 0;
   virtual void write(double token) = 0;
+  virtual void write(int64_t token) { char buf[24]; write(buf, itostr(token, buf)); }
   virtual void flush() = 0;
 };
 
@@ -245,18 +340,22 @@ template<typename input_base_t, typename out_t> class basic_buffered_writer_t :
   basic_buffered_writer_t& operator=(const basic_buffered_writer_t& other);
 
 protected:
-  static const size_t buf_cap = 32 * 1024;
-  char buf[buf_cap];
+  char* buf;
   char* next;
   char* end;
 
 public:
-  basic_buffered_writer_t() : next(buf), end(buf + buf_cap) {}
-  ~basic_buffered_writer_t() { if(next != buf) out_t::write(buf, next - buf, 1); }
+  basic_buffered_writer_t() : buf(new char[32 * 1024]), next(buf), end(buf + 32 * 1024) {}
+  ~basic_buffered_writer_t() { if(next != buf) out_t::write(buf, next - buf, 1); delete[] buf; }
+  void set_buffer_size(size_t size) { //writes at least this big skip the buffer
+    if(size < 64) throw runtime_error("buffer size is too small");
+    if(next != buf) { out_t::write(buf, next - buf); }
+    char* new_buf = new char[size]; delete[] buf; buf = new_buf; next = buf; end = buf + size;
+  }
   void write(char c) { *next++ = c; if(next == end) { out_t::write(buf, next - buf); next = buf; } }
   void write(const char* token, size_t len) {
     for(const char* tbegin = token; len;) {
-      if(next == buf && len >= buf_cap) { out_t::write(token, buf_cap); tbegin += buf_cap; len -= buf_cap; continue; }
+      if(next == buf && len >= size_t(end - buf)) { out_t::write(tbegin, len); break; }
       const size_t rem = end - next;
       size_t l = len > rem ? rem : len;
       memcpy(next, tbegin, l); next += l;
@@ -268,17 +367,26 @@ public:
     if(next + 32 < end) { size_t len = dtostr(token, next); next += len; }
     else { char buf[32]; size_t len = dtostr(token, buf); write(buf, len); }
   }
-  void flush() { if(next != buf) { out_t::write(buf, next - buf); next = buf; } }
+  void write(int64_t token) {
+    if(next + 24 < end) next += itostr(token, next);
+    else { char buf[24]; size_t len = itostr(token, buf); write(buf, len); }
+  }
+  void flush() { if(next != buf) { out_t::write(buf, next - buf); next = buf; } out_t::flush(); }
 };
 
-template<typename out_t> class writer_pass_t
+template<typename out_t, typename buffer_t = basic_buffered_writer_t<empty_buffered_writer_t, out_t> > class writer_pass_t
 {
 protected:
-  basic_buffered_writer_t<empty_buffered_writer_t, out_t> out;
+  buffer_t out;
   void output(char c) { out.write(c); }
   void output(const char* token, size_t len) { out.write(token, len); }
   void output(double token) { out.write(token); }
+  void output(int64_t token) { out.write(token); }
   void flush() { out.flush(); }
+  void close_out() { try { out.flush(); } catch(...) { try { out.close(); } catch(...) {} throw; } out.close(); } //closes even when the flush throws
+
+public:
+  void set_buffer_size(size_t size) { out.set_buffer_size(size); }
 };
 
 template<typename input_base_t> class basic_console_writer_t : public input_base_t
@@ -318,12 +426,15 @@ public:
     }
   }
 #endif
+  void flush() {}
 };
 
 class console_writer_t : public basic_console_writer_t<empty_writer_t> {};
 class dynamic_console_writer_t : public basic_console_writer_t<dynamic_writer_t> {};
 class console_writer_pass_t : public writer_pass_t<console_writer_t> { public: void set_fd(int fd) { out.set_fd(fd); } };
 
+enum file_sync_e { FS_NONE, FS_CLOSE, FS_PERIODIC }; //FS_PERIODIC also syncs at close
+
 template<typename input_base_t> class basic_file_writer_t : public input_base_t
 {
   basic_file_writer_t(const basic_file_writer_t& other);
@@ -332,39 +443,194 @@ template<typename input_base_t> class basic_file_writer_t : public input_base_t
   HANDLE h;
 #else
   int fd;
+  uint64_t reserved; //what posix_fallocate grew the file to, trimmed back at close
 #endif
+  uint64_t size_hint;
+  uint64_t written;
+  file_sync_e sync;
+  uint64_t sync_period;
+  uint64_t unsynced;
+
+  void sync_data() {
+#if defined(_WIN32)
+    if(!FlushFileBuffers(h)) throw runtime_error("can't sync output file");
+#elif defined(__APPLE__)
+    if(fsync(fd)) throw runtime_error("can't sync output file");
+#else
+    if(fdatasync(fd)) throw runtime_error("can't sync output file");
+#endif
+    unsynced = 0;
+  }
+  void wrote(size_t len) { written += len; if(sync == FS_PERIODIC && (unsynced += len) >= sync_period) sync_data(); }
 
 public:
+  void set_size_hint(uint64_t size) { size_hint = size; } //reserves the space at each open so the file is laid out in a few extents, if that grew the file it's trimmed at close
+  void set_sync(file_sync_e sync, uint64_t period = 64 * 1024 * 1024) { this->sync = sync; sync_period = period; }
 #ifdef _WIN32
-  basic_file_writer_t() : h(INVALID_HANDLE_VALUE) {}
+  basic_file_writer_t() : h(INVALID_HANDLE_VALUE), size_hint(0), written(0), sync(FS_NONE), sync_period(0), unsynced(0) {}
   ~basic_file_writer_t() { if(h != INVALID_HANDLE_VALUE) CloseHandle(h); }
-  void open(const char* path) { if(h != INVALID_HANDLE_VALUE) close(); h = CreateFile(path, GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL); if(h == INVALID_HANDLE_VALUE) throw runtime_error("can't open output file"); }
+  void open(const char* path) {
+    if(h != INVALID_HANDLE_VALUE) close();
+    h = CreateFile(path, GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL); if(h == INVALID_HANDLE_VALUE) throw runtime_error("can't open output file");
+    written = 0; unsynced = 0;
+    if(size_hint) { FILE_ALLOCATION_INFO info; info.AllocationSize.QuadPart = LONGLONG(size_hint); SetFileInformationByHandle(h, FileAllocationInfo, &info, sizeof(info)); } //just a hint
+  }
   void write(const void* buf, size_t len, bool silent = 0) {
     DWORD num_written; BOOL success = WriteFile(h, buf, len, &num_written, NULL);
     if(!silent && (!success || num_written != len)) { throw runtime_error("unable to write"); }
+    if(success) wrote(num_written);
+  }
+  void close() {
+    if(h == INVALID_HANDLE_VALUE) return;
+    if(sync != FS_NONE) sync_data();
+    if(!CloseHandle(h)) throw runtime_error("can't close output file");
+    h = INVALID_HANDLE_VALUE;
   }
-  void close() { if(h != INVALID_HANDLE_VALUE && !CloseHandle(h)) throw runtime_error("can't close output file"); h = INVALID_HANDLE_VALUE; }
 #else
-  basic_file_writer_t() : fd(-1) {}
-  ~basic_file_writer_t() { if(fd >= 0) ::close(fd); }
-  void open(const char* path) { if(fd < 0) close(); fd = ::open(path, O_WRONLY | O_TRUNC | O_CREAT | O_BINARY, S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH); if(fd < 0) throw runtime_error("can't open output file"); }
+  basic_file_writer_t() : fd(-1), reserved(0), size_hint(0), written(0), sync(FS_NONE), sync_period(0), unsynced(0) {}
+  ~basic_file_writer_t() { if(fd >= 0) { if(reserved > written && ftruncate(fd, off_t(written))) {} ::close(fd); } }
+  void open(const char* path) {
+    if(fd >= 0) close();
+    fd = ::open(path, O_WRONLY | O_TRUNC | O_CREAT | O_BINARY, S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH); if(fd < 0) throw runtime_error("can't open output file");
+    written = 0; unsynced = 0; reserved = 0;
+    //just a hint, not every file system can
+#if defined(__linux__)
+    if(size_hint) fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, off_t(size_hint));
+#elif !defined(__APPLE__)
+    if(size_hint && !posix_fallocate(fd, 0, off_t(size_hint))) reserved = size_hint;
+#endif
+  }
   void write(const void* buf, size_t len, bool silent = 0) {
     for(const void* begin = buf; len;) {
       ssize_t num_written = ::write(fd, begin, len);
-      if(num_written == (ssize_t)len) { break; }
-      else if(num_written >= 0) { begin = static_cast<const char*>(begin) + num_written; len -= num_written; }
+      if(num_written == (ssize_t)len) { wrote(len); break; }
+      else if(num_written >= 0) { wrote(num_written); begin = static_cast<const char*>(begin) + num_written; len -= num_written; }
       else if(errno == EINTR) { continue; }
       else if(!silent) { throw runtime_error("unable to write"); }
       else { break; }
     }
   }
-  void close() { if(fd >= 0 && ::close(fd)) throw runtime_error("can't close output file"); fd = -1; }
+  void close() {
+    if(fd < 0) return;
+    if(reserved > written && ftruncate(fd, off_t(written))) throw runtime_error("can't trim output file");
+    if(sync != FS_NONE) sync_data();
+    if(::close(fd)) { fd = -1; throw runtime_error("can't close output file"); }
+    fd = -1;
+  }
 #endif
+  void flush() {}
 };
 
 class file_writer_t : public basic_file_writer_t<empty_writer_t> {};
 class dynamic_file_writer_t : public basic_file_writer_t<dynamic_writer_t> {};
-class file_writer_pass_t : public writer_pass_t<file_writer_t> { public: void open(const char* path) { out.open(path); } void close() { out.close(); } };
+class file_writer_pass_t : public writer_pass_t<file_writer_t> { public: void open(const char* path) { out.open(path); } void close() { close_out(); } void set_size_hint(uint64_t size) { out.set_size_hint(size); } void set_sync(file_sync_e sync, uint64_t period = 64 * 1024 * 1024) { out.set_sync(sync, period); } };
+
+template<typename writer_t> class async_writer_t : public writer_t //a thread drains a ring of buffers through writer_t, flush waits for it and joins
+{ //tokens are written straight into the ring, so it stands in for basic_buffered_writer_t
+  async_writer_t(const async_writer_t& other);
+  async_writer_t& operator=(const async_writer_t& other);
+
+protected:
+  static void* async_writer_main(void* data);
+
+  size_t buf_count;
+  size_t buf_size;
+  vector<char*> bufs;
+  vector<size_t> lens;
+  size_t write_buf;
+  char* next; //the rest of bufs[write_buf]
+  char* end;
+  size_t read_buf;
+  size_t filled;
+  bool done;
+  bool error;
+  string error_msg;
+  bool thread_created;
+  pthread_mutex_t mutex;
+  pthread_cond_t prod_cond;
+  pthread_cond_t cons_cond;
+  pthread_t thread;
+
+  void start();
+  void hand_off();
+  void next_buf();
+
+public:
+  async_writer_t() : buf_count(4), buf_size(1024 * 1024), write_buf(0), next(0), end(0), thread_created(0) {}
+  ~async_writer_t() { try { flush(); } catch(...) {} for(vector<char*>::iterator i = bufs.begin(); i != bufs.end(); ++i) delete[] *i; }
+  void set_async(size_t buf_count, size_t buf_size);
+  void set_buffer_size(size_t size) { set_async(buf_count, size); }
+  void write(char c) { if(next == end) next_buf(); *next++ = c; }
+  void write(const char* token, size_t len);
+  void write(double token) {
+    if(size_t(end - next) >= 32) next += dtostr(token, next);
+    else { char buf[32]; size_t len = dtostr(token, buf); write(buf, len); }
+  }
+  void write(int64_t token) {
+    if(size_t(end - next) >= 24) next += itostr(token, next);
+    else { char buf[24]; size_t len = itostr(token, buf); write(buf, len); }
+  }
+  void flush();
+};
+
+class async_console_writer_pass_t : public writer_pass_t<console_writer_t, async_writer_t<console_writer_t> > { public: void set_fd(int fd) { out.set_fd(fd); } void set_async(size_t buf_count, size_t buf_size) { out.set_async(buf_count, buf_size); } };
+class async_file_writer_pass_t : public writer_pass_t<file_writer_t, async_writer_t<file_writer_t> > { public: void open(const char* path) { out.open(path); } void close() { close_out(); } void set_async(size_t buf_count, size_t buf_size) { out.set_async(buf_count, buf_size); } void set_size_hint(uint64_t size) { out.set_size_hint(size); } void set_sync(file_sync_e sync, uint64_t period = 64 * 1024 * 1024) { out.set_sync(sync, period); } };
+
+#ifdef TABLE_ZLIB
+class gzip_file_writer_t
+{
+  gzip_file_writer_t(const gzip_file_writer_t& other);
+  gzip_file_writer_t& operator=(const gzip_file_writer_t& other);
+
+  gzFile f;
+  int level;
+
+public:
+  gzip_file_writer_t() : f(0), level(6) {}
+  ~gzip_file_writer_t() { if(f) gzclose(f); }
+  void set_level(int level) { this->level = level; }
+  void open(const char* path) { if(f) close(); char mode[] = "wb6"; mode[2] = char('0' + max(0, min(level, 9))); f = gzopen(path, mode); if(!f) throw runtime_error("can't open output file"); gzbuffer(f, 128 * 1024); }
+  void write(const void* buf, size_t len, bool silent = 0) {
+    for(const char* begin = static_cast<const char*>(buf); len;) {
+      const unsigned l = unsigned(min(len, size_t(1 << 30)));
+      if(gzwrite(f, begin, l) != int(l)) { if(!silent) throw runtime_error("couldn't compress"); break; }
+      begin += l; len -= l;
+    }
+  }
+  void close() { if(f && gzclose(f) != Z_OK) throw runtime_error("can't close output file"); f = 0; }
+  void flush() {}
+};
+
+class gzip_file_writer_pass_t : public writer_pass_t<gzip_file_writer_t, async_writer_t<gzip_file_writer_t> > { public: void open(const char* path) { out.open(path); } void close() { close_out(); } void set_level(int level) { out.set_level(level); } void set_async(size_t buf_count, size_t buf_size) { out.set_async(buf_count, buf_size); } };
+#endif
+
+#ifdef TABLE_ZSTD
+class zstd_file_writer_t
+{
+  zstd_file_writer_t(const zstd_file_writer_t& other);
+  zstd_file_writer_t& operator=(const zstd_file_writer_t& other);
+
+  file_writer_t f;
+  ZSTD_CStream* cs;
+  char* out_buf;
+  size_t out_cap;
+  int level;
+  bool is_open;
+
+  void compress(ZSTD_inBuffer& in, ZSTD_EndDirective mode);
+
+public:
+  zstd_file_writer_t() : cs(0), out_buf(0), out_cap(0), level(3), is_open(0) {}
+  ~zstd_file_writer_t() { try { close(); } catch(...) {} if(cs) ZSTD_freeCStream(cs); delete[] out_buf; }
+  void set_level(int level) { this->level = level; }
+  void open(const char* path);
+  void write(const void* buf, size_t len, bool silent = 0);
+  void close();
+  void flush() {}
+};
+
+class zstd_file_writer_pass_t : public writer_pass_t<zstd_file_writer_t, async_writer_t<zstd_file_writer_t> > { public: void open(const char* path) { out.open(path); } void close() { close_out(); } void set_level(int level) { out.set_level(level); } void set_async(size_t buf_count, size_t buf_size) { out.set_async(buf_count, buf_size); } };
+#endif
 
 
 ////////////////////////////////////////////////////////////////////////////////////////////////
@@ -376,23 +642,36 @@ template<typename input_base_t, typename output_base_t> class basic_tabular_writ
 protected:
   size_t line;
   size_t column;
+  size_t sample_lines;
+  bool truncate;
+  bool sampled;
   vector<size_t> max_width;
-  vector<char*> data;
+  vector<char*> data; //the sampled tokens, each after its length, a block ends with a length of -1
   char* next;
   char* end;
+  string pad;
 
-  basic_tabular_writer_t() : line(0), column(0), next(0), end(0) {}
+  basic_tabular_writer_t() : line(0), column(0), sample_lines(19), truncate(0), sampled(0), next(0), end(0) {}
+  ~basic_tabular_writer_t() { for(vector<char*>::iterator i = data.begin(); i != data.end(); ++i) delete[] *i; }
   void process_data();
+  void output_cell(const char* token, size_t len) {
+    size_t& width = max_width[column];
+    if(len > width) { if(truncate) len = width; else { width = len; if(pad.size() <= width) pad.assign(width + 1, ' '); } }
+    this->output(pad.data(), 1 + width - len);
+    this->output(token, len);
+  }
 
 public:
+  void set_sample_lines(size_t lines) { sample_lines = lines; } //lines sampled to size the columns, 19 by default
+  void set_truncate(bool truncate) { this->truncate = truncate; } //cut cells wider than their column after the sample instead of widening it
   void reinit(int more_passes = 0) { reinit_state(); }
   void reinit_state(int more_passes = 0);
   void process_key(const char* token, size_t len);
-  void process_keys() { this->output('\n'); ++line; column = 0; }
+  void process_keys() { this->output('\n'); ++line; column = 0; if(!sample_lines) process_data(); }
   void process_token(const char* token, size_t len);
   void process_token(double token) { char buf[32]; size_t len = dtostr(token, buf); process_token(buf, len); }
-  void process_line() { if(line == 19) process_data(); else if(line > 19) this->output('\n'); ++line; column = 0; }
-  void process_stream() { if(line <= 19) process_data(); this->flush(); }
+  void process_line() { if(line == sample_lines) process_data(); else if(line > sample_lines) this->output('\n'); ++line; column = 0; }
+  void process_stream() { if(!sampled) process_data(); this->flush(); }
 };
 
 class tabular_writer : public basic_tabular_writer_t<empty_pass_t, console_writer_pass_t> { public: tabular_writer() {} tabular_writer(int fd) { set_fd(fd); } };
@@ -405,6 +684,29 @@ class dynamic_tabular_file_writer : public basic_tabular_writer_t<dynamic_pass_t
 // csv_writer
 ////////////////////////////////////////////////////////////////////////////////////////////////
 
+inline bool csv_needs_quote(const char* token, size_t len) //true if token has a ',', '"', '\n' or '\r'
+{
+  const char* p = token;
+  const char* end = token + len;
+#if defined(__AVX2__)
+  const __m256i comma = _mm256_set1_epi8(','), quote = _mm256_set1_epi8('"'), nl = _mm256_set1_epi8('\n'), cr = _mm256_set1_epi8('\r');
+  for(; p + 32 <= end; p += 32) {
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+    __m256i m = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, comma), _mm256_cmpeq_epi8(v, quote)), _mm256_or_si256(_mm256_cmpeq_epi8(v, nl), _mm256_cmpeq_epi8(v, cr)));
+    if(_mm256_movemask_epi8(m)) return 1;
+  }
+#elif defined(__SSE2__)
+  const __m128i comma = _mm_set1_epi8(','), quote = _mm_set1_epi8('"'), nl = _mm_set1_epi8('\n'), cr = _mm_set1_epi8('\r');
+  for(; p + 16 <= end; p += 16) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    __m128i m = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, comma), _mm_cmpeq_epi8(v, quote)), _mm_or_si128(_mm_cmpeq_epi8(v, nl), _mm_cmpeq_epi8(v, cr)));
+    if(_mm_movemask_epi8(m)) return 1;
+  }
+#endif
+  for(; p < end; ++p) if(*p == ',' || *p == '"' || *p == '\n' || *p == '\r') return 1;
+  return 0;
+}
+
 template<typename input_base_t, typename output_base_t> class basic_csv_writer_t : public input_base_t, public output_base_t
 {
 protected:
@@ -415,6 +717,20 @@ protected:
 
   basic_csv_writer_t() : show_keys_(1), column(0) {}
 
+  //RFC 4180, a field with a delimiter, quote or line break is quoted and its quotes doubled
+  void output_field(const char* token, size_t len) {
+    if(!csv_needs_quote(token, len)) { output_base_t::output(token, len); return; }
+    output_base_t::output('"');
+    for(const char* end = token + len; token < end;) {
+      const char* q = static_cast<const char*>(memchr(token, '"', end - token));
+      if(!q) { output_base_t::output(token, end - token); break; }
+      output_base_t::output(token, q + 1 - token);
+      output_base_t::output('"');
+      token = q + 1;
+    }
+    output_base_t::output('"');
+  }
+
 public:
   void hide_keys() { show_keys_ = 0; }
   void show_keys() { show_keys_ = 1; }
@@ -423,13 +739,15 @@ public:
   void process_key(const char* token, size_t len) { 
     if(show_keys_) {
       if(column) output_base_t::output(',');
-      output_base_t::output(token, len);
+      output_field(token, len);
     }
     ++column;
   }
   void process_keys() { if(show_keys_) output_base_t::output('\n'); num_columns = column; column = 0; line = 1; }
-  void process_token(const char* token, size_t len) { if(column) output_base_t::output(','); output_base_t::output(token, len); ++column; }
-  void process_token(double token) { char buf[32]; size_t len = dtostr(token, buf); process_token(buf, len); }
+  void process_token(const char* token, size_t len) { if(column) output_base_t::output(','); output_field(token, len); ++column; }
+  void process_token(double token) { if(column) output_base_t::output(','); output_base_t::output(token); ++column; }
+  void process_token(int64_t token) { if(column) output_base_t::output(','); output_base_t::output(token); ++column; }
+  void process_null() { if(column) output_base_t::output(','); ++column; }
   void process_line() {
     if(column != num_columns) {
       stringstream msg; msg << "csv_writer: line " << line << " (zero's based) has " << column << " columns instead of " << num_columns;
@@ -437,6 +755,10 @@ public:
     }
     output_base_t::output('\n'); column = 0; ++line;
   }
+  void process_block(const row_block_t& block) {
+    direct_pass_t<basic_csv_writer_t> d(*this);
+    block.replay(d);
+  }
   void process_stream() {
     this->flush();
     if(line && column) throw runtime_error("csv_writer saw process_stream called after process_token");
@@ -450,6 +772,368 @@ class csv_writer : public basic_csv_writer_t<empty_pass_t, console_writer_pass_t
 class dynamic_csv_writer : public basic_csv_writer_t<dynamic_pass_t, console_writer_pass_t> { public: dynamic_csv_writer() {} dynamic_csv_writer(int fd) { set_fd(fd); } };
 class csv_file_writer : public basic_csv_writer_t<empty_pass_t, file_writer_pass_t> { public: csv_file_writer() {} csv_file_writer(const char* path) { open(path); } };
 class dynamic_csv_file_writer : public basic_csv_writer_t<dynamic_pass_t, file_writer_pass_t> { public: dynamic_csv_file_writer() {} dynamic_csv_file_writer(const char* path) { open(path); } };
+class async_csv_writer : public basic_csv_writer_t<empty_pass_t, async_console_writer_pass_t> { public: async_csv_writer() {} async_csv_writer(int fd) { set_fd(fd); } };
+class async_csv_file_writer : public basic_csv_writer_t<empty_pass_t, async_file_writer_pass_t> { public: async_csv_file_writer() {} async_csv_file_writer(const char* path) { open(path); } };
+#ifdef TABLE_ZLIB
+class csv_gzip_file_writer : public basic_csv_writer_t<empty_pass_t, gzip_file_writer_pass_t> { public: csv_gzip_file_writer() {} csv_gzip_file_writer(const char* path) { open(path); } };
+#endif
+#ifdef TABLE_ZSTD
+class csv_zstd_file_writer : public basic_csv_writer_t<empty_pass_t, zstd_file_writer_pass_t> { public: csv_zstd_file_writer() {} csv_zstd_file_writer(const char* path) { open(path); } };
+#endif
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+// partitioned_writer
+////////////////////////////////////////////////////////////////////////////////////////////////
+
+template<typename input_base_t, typename writer_t> class basic_partitioned_writer_t : public input_base_t //writes each line to one of N writer_t's picked by a hash of the partition key columns
+{
+  basic_partitioned_writer_t(const basic_partitioned_writer_t<input_base_t, writer_t>& other);
+  basic_partitioned_writer_t& operator=(const basic_partitioned_writer_t<input_base_t, writer_t>& other);
+
+protected:
+  struct stream_end_t { writer_t* w; string error_msg; bool error; bool joinable; pthread_t thread; };
+  static void* stream_end_main(void* data);
+
+  //a line goes straight to its partition once the last key column has been hashed, only the tokens before that are held
+  vector<writer_t*> partitions;
+  vector<string> part_keys;
+  vector<char> part_columns;
+  size_t last_part_column; //one past it
+  vector<string> keys;
+  vector<char> row;
+  uint32_t hash;
+  writer_t* w;
+  size_t column;
+  size_t line;
+
+  void start_line();
+  void hash_token(const char* token, size_t len);
+  void pick_partition();
+
+public:
+  basic_partitioned_writer_t() : last_part_column(0), w(0), column(0), line(0) {}
+  ~basic_partitioned_writer_t() { for(typename vector<writer_t*>::iterator i = partitions.begin(); i != partitions.end(); ++i) delete *i; }
+  void reinit(int more_passes = 0) { reinit_state(); }
+  void reinit_state(int more_passes = 0) { keys.clear(); column = 0; line = 0; }
+  void add_key(const char* key) { part_keys.push_back(key); } //with no keys the lines are dealt out in turn
+  void open(const char* prefix, size_t count, const char* suffix = ".csv"); //partition i goes to prefix, i and suffix
+  void close() { for(typename vector<writer_t*>::iterator i = partitions.begin(); i != partitions.end(); ++i) (*i)->close(); }
+  size_t get_partition_count() const { return partitions.size(); }
+  writer_t& get_partition(size_t i) { return *partitions[i]; }
+  void process_key(const char* token, size_t len) { keys.push_back(string(token, len)); for(typename vector<writer_t*>::iterator i = partitions.begin(); i != partitions.end(); ++i) (*i)->process_key(token, len); }
+  void process_keys();
+  void process_token(const char* token, size_t len);
+  void process_token(double token);
+  void process_line();
+  void process_stream();
+};
+
+class partitioned_csv_file_writer : public basic_partitioned_writer_t<empty_pass_t, csv_file_writer> {};
+class dynamic_partitioned_csv_file_writer : public basic_partitioned_writer_t<dynamic_pass_t, csv_file_writer> {};
+class partitioned_async_csv_file_writer : public basic_partitioned_writer_t<empty_pass_t, async_csv_file_writer> {}; //each partition writes on its own thread
+#ifdef TABLE_ZLIB
+class partitioned_csv_gzip_file_writer : public basic_partitioned_writer_t<empty_pass_t, csv_gzip_file_writer> {};
+#endif
+#ifdef TABLE_ZSTD
+class partitioned_csv_zstd_file_writer : public basic_partitioned_writer_t<empty_pass_t, csv_zstd_file_writer> {};
+#endif
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+// binary_writer
+////////////////////////////////////////////////////////////////////////////////////////////////
+
+//the binary row format starts with an 8 byte header: "\x7fTBL", the version, the byte order of the doubles (1 little, 2 big) and two 0's
+//then come tagged records, keys and string tokens carry a varint length so they can hold any bytes, doubles are the raw 8 bytes
+enum binary_tag_e { BT_KEY = 1, BT_KEYS = 2, BT_DOUBLE = 3, BT_LINE = 4, BT_STREAM = 6, BT_TOKEN = 7 };
+const char binary_magic[] = "\x7fTBL";
+const unsigned char binary_version = 1;
+
+inline unsigned char binary_byte_order() { const uint16_t one = 1; return *reinterpret_cast<const unsigned char*>(&one) ? 1 : 2; }
+inline double binary_double(const char* bytes, bool swap) {
+  double value; char* v = reinterpret_cast<char*>(&value);
+  if(swap) reverse_copy(bytes, bytes + sizeof(double), v); else memcpy(v, bytes, sizeof(double));
+  return value;
+}
+
+template<typename input_base_t, typename output_base_t> class basic_binary_writer_t : public input_base_t, public output_base_t
+{
+protected:
+  bool header_written;
+
+  basic_binary_writer_t() : header_written(0) {}
+  void output_header() {
+    if(header_written) return;
+    const char header[8] = { binary_magic[0], binary_magic[1], binary_magic[2], binary_magic[3], char(binary_version), char(binary_byte_order()), 0, 0 };
+    output_base_t::output(header, sizeof(header));
+    header_written = 1;
+  }
+  void output_tag(binary_tag_e tag, size_t len) {
+    output_header();
+    char buf[12]; char* next = buf;
+    *next++ = char(tag);
+    for(; len >= 0x80; len >>= 7) *next++ = char((len & 0x7f) | 0x80);
+    *next++ = char(len);
+    output_base_t::output(buf, next - buf);
+  }
+
+public:
+  void reinit(int more_passes = 0) { reinit_state(); }
+  void reinit_state(int more_passes = 0) { header_written = 0; }
+  void process_key(const char* token, size_t len) { output_tag(BT_KEY, len); output_base_t::output(token, len); }
+  void process_keys() { output_header(); output_base_t::output(char(BT_KEYS)); }
+  void process_token(const char* token, size_t len) { output_tag(BT_TOKEN, len); output_base_t::output(token, len); }
+  void process_token(double token) { output_header(); char buf[1 + sizeof(double)]; buf[0] = char(BT_DOUBLE); memcpy(buf + 1, &token, sizeof(double)); output_base_t::output(buf, sizeof(buf)); }
+  void process_line() { output_header(); output_base_t::output(char(BT_LINE)); }
+  void process_stream() { output_header(); output_base_t::output(char(BT_STREAM)); this->flush(); header_written = 0; }
+};
+
+class binary_writer : public basic_binary_writer_t<empty_pass_t, console_writer_pass_t> { public: binary_writer() {} binary_writer(int fd) { set_fd(fd); } };
+class dynamic_binary_writer : public basic_binary_writer_t<dynamic_pass_t, console_writer_pass_t> { public: dynamic_binary_writer() {} dynamic_binary_writer(int fd) { set_fd(fd); } };
+class binary_file_writer : public basic_binary_writer_t<empty_pass_t, file_writer_pass_t> { public: binary_file_writer() {} binary_file_writer(const char* path) { open(path); } };
+class dynamic_binary_file_writer : public basic_binary_writer_t<dynamic_pass_t, file_writer_pass_t> { public: dynamic_binary_file_writer() {} dynamic_binary_file_writer(const char* path) { open(path); } };
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+// columnar_writer
+////////////////////////////////////////////////////////////////////////////////////////////////
+
+//the columnar format starts with an 8 byte header like the binary row format but with "\x7fTBC", then the key count and keys
+//rows are stored in blocks, each block has its row count, then per column: number count, null count, estimated distinct count,
+//min and max of the numbers, the codec and the raw and stored lengths, then each column's cells one after another
+//a cell is a tag: BT_NULL for an empty token, BT_DOUBLE and 8 bytes, or BT_TOKEN, a varint length and the bytes
+//the number count, min and max take in tokens that parse_number reads as numbers as well as the doubles
+//a block with 0 rows ends the stream
+enum { BT_NULL = 0 };
+enum block_codec_e { BC_NONE = 0, BC_ZLIB = 1, BC_ZSTD = 2 };
+const char columnar_magic[] = "\x7fTBC";
+const unsigned char columnar_version = 1;
+
+extern char compress_block(const vector<char>& in, vector<char>& out); //returns the codec used, BC_NONE if compressing didn't help
+extern void decompress_block(char codec, const char* in, size_t len, char* out, size_t raw_len);
+
+template<typename input_base_t, typename output_base_t> class basic_columnar_writer_t : public input_base_t, public output_base_t
+{
+  basic_columnar_writer_t(const basic_columnar_writer_t<input_base_t, output_base_t>& other);
+  basic_columnar_writer_t& operator=(const basic_columnar_writer_t<input_base_t, output_base_t>& other);
+
+protected:
+  enum { distinct_bits = 4096 };
+  struct column_t {
+    vector<char> cells;
+    size_t numbers;
+    size_t nulls;
+    double min;
+    double max;
+    uint64_t distinct[distinct_bits / 64]; //linear counting bitmap of the cells' hashes
+  };
+
+  vector<string> keys;
+  vector<column_t> columns;
+  vector<char> packed;
+  size_t block_rows;
+  size_t rows;
+  size_t column;
+  size_t line;
+
+  basic_columnar_writer_t() : block_rows(64 * 1024) { reinit_state(); }
+  void output_varint(size_t value) { char buf[10]; char* next = buf; for(; value >= 0x80; value >>= 7) *next++ = char((value & 0x7f) | 0x80); *next++ = char(value); output_base_t::output(buf, next - buf); }
+  column_t& next_column();
+  void add_cell(column_t& c, const char* cell, size_t len);
+  static void clear_column(column_t& c) { c.cells.clear(); c.numbers = 0; c.nulls = 0; c.min = 0.0; c.max = 0.0; memset(c.distinct, 0, sizeof(c.distinct)); }
+  static size_t distinct_estimate(const column_t& c);
+  void output_block();
+
+public:
+  void set_block_rows(size_t block_rows) { if(!block_rows) throw runtime_error("invalid block rows"); this->block_rows = block_rows; }
+  void reinit(int more_passes = 0) { reinit_state(); }
+  void reinit_state(int more_passes = 0) { keys.clear(); columns.clear(); rows = 0; column = 0; line = 0; }
+  void process_key(const char* token, size_t len) { keys.push_back(string(token, len)); }
+  void process_keys();
+  void process_token(const char* token, size_t len);
+  void process_token(double token);
+  void process_line();
+  void process_stream();
+};
+
+class columnar_writer : public basic_columnar_writer_t<empty_pass_t, console_writer_pass_t> { public: columnar_writer() {} columnar_writer(int fd) { set_fd(fd); } };
+class dynamic_columnar_writer : public basic_columnar_writer_t<dynamic_pass_t, console_writer_pass_t> { public: dynamic_columnar_writer() {} dynamic_columnar_writer(int fd) { set_fd(fd); } };
+class columnar_file_writer : public basic_columnar_writer_t<empty_pass_t, file_writer_pass_t> { public: columnar_file_writer() {} columnar_file_writer(const char* path) { open(path); } };
+class dynamic_columnar_file_writer : public basic_columnar_writer_t<dynamic_pass_t, file_writer_pass_t> { public: dynamic_columnar_file_writer() {} dynamic_columnar_file_writer(const char* path) { open(path); } };
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+// jsonl_writer
+////////////////////////////////////////////////////////////////////////////////////////////////
+
+inline const char* json_escape_find(const char* p, const char* end) //the first '"', '\\' or control character
+{
+#if defined(__AVX2__)
+  const __m256i quote = _mm256_set1_epi8('"'), bslash = _mm256_set1_epi8('\\'), ctrl = _mm256_set1_epi8(0x1f);
+  for(; p + 32 <= end; p += 32) {
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+    __m256i m = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, quote), _mm256_cmpeq_epi8(v, bslash)), _mm256_cmpeq_epi8(_mm256_min_epu8(v, ctrl), v));
+    const uint32_t mask = _mm256_movemask_epi8(m);
+    if(mask) return p + __builtin_ctz(mask);
+  }
+#elif defined(__SSE2__)
+  const __m128i quote = _mm_set1_epi8('"'), bslash = _mm_set1_epi8('\\'), ctrl = _mm_set1_epi8(0x1f);
+  for(; p + 16 <= end; p += 16) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    __m128i m = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, bslash)), _mm_cmpeq_epi8(_mm_min_epu8(v, ctrl), v));
+    const uint32_t mask = _mm_movemask_epi8(m);
+    if(mask) return p + __builtin_ctz(mask);
+  }
+#endif
+  while(p < end && *p != '"' && *p != '\\' && (unsigned char)*p > 0x1f) ++p;
+  return p;
+}
+
+inline size_t json_escape_char(char c, char* buf) //buf needs 6 chars
+{
+  static const char hex[] = "0123456789abcdef";
+  buf[0] = '\\';
+  if(c == '"' || c == '\\') { buf[1] = c; return 2; }
+  else if(c == '\n') { buf[1] = 'n'; return 2; }
+  else if(c == '\r') { buf[1] = 'r'; return 2; }
+  else if(c == '\t') { buf[1] = 't'; return 2; }
+  buf[1] = 'u'; buf[2] = '0'; buf[3] = '0'; buf[4] = hex[(c >> 4) & 0xf]; buf[5] = hex[c & 0xf];
+  return 6;
+}
+
+template<typename input_base_t, typename output_base_t> class basic_jsonl_writer_t : public input_base_t, public output_base_t //one object per line, keys are the columns
+{
+protected:
+  vector<string> keys; //already quoted and followed by ':'
+  size_t column;
+  size_t line;
+
+  basic_jsonl_writer_t() : column(0), line(0) {}
+  void output_string(const char* token, size_t len) {
+    output_base_t::output('"');
+    for(const char* end = token + len; token < end;) {
+      const char* e = json_escape_find(token, end);
+      output_base_t::output(token, e - token);
+      if(e == end) break;
+      char buf[6]; output_base_t::output(buf, json_escape_char(*e, buf));
+      token = e + 1;
+    }
+    output_base_t::output('"');
+  }
+  void output_key() {
+    if(column == keys.size()) {
+      stringstream msg; msg << "jsonl_writer: line " << line << " (zero's based) has more than " << keys.size() << " columns";
+      throw runtime_error(msg.str());
+    }
+    output_base_t::output(column ? ',' : '{');
+    output_base_t::output(keys[column].c_str(), keys[column].size());
+    ++column;
+  }
+
+public:
+  void reinit(int more_passes = 0) { reinit_state(); }
+  void reinit_state(int more_passes = 0) { keys.clear(); column = 0; line = 0; }
+  void process_key(const char* token, size_t len) {
+    string key("\"");
+    for(const char* end = token + len; token < end;) {
+      const char* e = json_escape_find(token, end);
+      key.append(token, e);
+      if(e == end) break;
+      char buf[6]; key.append(buf, json_escape_char(*e, buf));
+      token = e + 1;
+    }
+    keys.push_back(key + "\":");
+  }
+  void process_keys() { column = 0; line = 0; }
+  void process_token(const char* token, size_t len) { output_key(); output_string(token, len); }
+  void process_token(double token) { output_key(); if(token - token == 0.0) output_base_t::output(token); else output_base_t::output("null", 4); } //JSON has no NaN or inf
+  void process_token(int64_t token) { output_key(); output_base_t::output(token); }
+  void process_null() { output_key(); output_base_t::output("null", 4); }
+  void process_line() {
+    if(column != keys.size()) {
+      stringstream msg; msg << "jsonl_writer: line " << line << " (zero's based) has " << column << " columns instead of " << keys.size();
+      throw runtime_error(msg.str());
+    }
+    if(!column) output_base_t::output('{');
+    output_base_t::output("}\n", 2); column = 0; ++line;
+  }
+  void process_stream() {
+    this->flush();
+    if(column) throw runtime_error("jsonl_writer saw process_stream called after process_token");
+  }
+};
+
+class jsonl_writer : public basic_jsonl_writer_t<empty_pass_t, console_writer_pass_t> { public: jsonl_writer() {} jsonl_writer(int fd) { set_fd(fd); } };
+class dynamic_jsonl_writer : public basic_jsonl_writer_t<dynamic_pass_t, console_writer_pass_t> { public: dynamic_jsonl_writer() {} dynamic_jsonl_writer(int fd) { set_fd(fd); } };
+class jsonl_file_writer : public basic_jsonl_writer_t<empty_pass_t, file_writer_pass_t> { public: jsonl_file_writer() {} jsonl_file_writer(const char* path) { open(path); } };
+class dynamic_jsonl_file_writer : public basic_jsonl_writer_t<dynamic_pass_t, file_writer_pass_t> { public: dynamic_jsonl_file_writer() {} dynamic_jsonl_file_writer(const char* path) { open(path); } };
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+// arrow_writer
+////////////////////////////////////////////////////////////////////////////////////////////////
+
+//the framed flatbuffer metadata of an Arrow IPC stream message, the columns are float64 if is_double else utf8
+extern void arrow_schema_message(const vector<string>& names, const vector<char>& is_double, vector<char>& msg);
+//nodes are length and null count pairs, buffers are offset and length pairs
+extern void arrow_record_batch_message(size_t rows, const vector<int64_t>& nodes, const vector<int64_t>& buffers, size_t body_len, vector<char>& msg);
+
+template<typename input_base_t, typename output_base_t> class basic_arrow_writer_t : public input_base_t, public output_base_t //an Arrow IPC stream
+{
+  basic_arrow_writer_t(const basic_arrow_writer_t<input_base_t, output_base_t>& other);
+  basic_arrow_writer_t& operator=(const basic_arrow_writer_t<input_base_t, output_base_t>& other);
+
+protected:
+  //the column types are picked from the first batch, which is built as both float64 and utf8 until then
+  //a column is float64 if it saw a double and otherwise only empty tokens, empty tokens are nulls in it
+  //a column with nothing but empty tokens in the first batch is utf8, so text later on in a sparse column still fits
+  //text after the first batch that isn't a number is a null in a float64 column, set_batch_rows decides how much is looked at
+  struct column_t {
+    bool is_double; //still could be float64 while the first batch is built
+    bool saw_double;
+    vector<unsigned char> validity;
+    size_t null_count;
+    vector<double> values;
+    vector<unsigned char> text_validity; //the utf8 validity while the first batch is built
+    size_t text_null_count;
+    vector<int32_t> offsets;
+    vector<char> data;
+  };
+
+  vector<string> keys;
+  vector<column_t> columns;
+  size_t batch_rows;
+  size_t rows;
+  size_t column;
+  bool schema_written;
+
+  basic_arrow_writer_t() : batch_rows(64 * 1024) { reinit_state(); }
+  column_t& next_column();
+  void add_double(column_t& c, double value, bool valid);
+  void add_text(column_t& c, const char* token, size_t len, bool valid);
+  void add_cell(column_t& c, const char* token, size_t len);
+  void add_cell(column_t& c, double token);
+  void output_schema();
+  void output_batch();
+
+public:
+  void set_batch_rows(size_t batch_rows) { if(!batch_rows) throw runtime_error("invalid batch rows"); this->batch_rows = batch_rows; } //64K by default, also the rows the column types are picked from
+  void reinit(int more_passes = 0) { reinit_state(); }
+  void reinit_state(int more_passes = 0) { keys.clear(); columns.clear(); rows = 0; column = 0; schema_written = 0; }
+  void process_key(const char* token, size_t len) { keys.push_back(string(token, len)); }
+  void process_keys();
+  void process_token(const char* token, size_t len) { add_cell(next_column(), token, len); }
+  void process_token(double token) { add_cell(next_column(), token); }
+  void process_null();
+  void process_line();
+  void process_stream();
+};
+
+class arrow_writer : public basic_arrow_writer_t<empty_pass_t, console_writer_pass_t> { public: arrow_writer() {} arrow_writer(int fd) { set_fd(fd); } };
+class dynamic_arrow_writer : public basic_arrow_writer_t<dynamic_pass_t, console_writer_pass_t> { public: dynamic_arrow_writer() {} dynamic_arrow_writer(int fd) { set_fd(fd); } };
+class arrow_file_writer : public basic_arrow_writer_t<empty_pass_t, file_writer_pass_t> { public: arrow_file_writer() {} arrow_file_writer(const char* path) { open(path); } };
+class dynamic_arrow_file_writer : public basic_arrow_writer_t<dynamic_pass_t, file_writer_pass_t> { public: dynamic_arrow_file_writer() {} dynamic_arrow_file_writer(const char* path) { open(path); } };
 
 
 ////////////////////////////////////////////////////////////////////////////////////////////////
@@ -505,48 +1189,566 @@ public:
 #endif
 };
 
-template<typename reader_t, typename output_base_t> class csv_reader_base_t : public output_base_t
+template<typename reader_t> class read_ahead_reader_t : public reader_t //reads into a ring of buffers on its own thread
 {
-  csv_reader_base_t(const csv_reader_base_t<reader_t, output_base_t>& other);
-  csv_reader_base_t& operator=(const csv_reader_base_t<reader_t, output_base_t>& other);
+  read_ahead_reader_t(const read_ahead_reader_t& other);
+  read_ahead_reader_t& operator=(const read_ahead_reader_t& other);
 
 protected:
-  reader_t r;
-  size_t line;
-  size_t num_keys;
-  size_t column;
-  char* buf;
-  const char* start;
-  char* data_end;
-  char* buf_end;
-  bool in_keys;
+  static void* read_ahead_main(void* data);
+
+  size_t buf_count;
+  size_t buf_size;
+  vector<char*> bufs;
+  vector<size_t> lens;
+  size_t write_buf;
+  size_t read_buf;
+  size_t filled;
+  size_t read_off;
+  bool have_read_buf;
+  bool error;
+  string error_msg;
+  bool abort;
+  bool thread_created;
+  pthread_mutex_t mutex;
+  pthread_cond_t prod_cond;
+  pthread_cond_t cons_cond;
+  pthread_t thread;
 
-  csv_reader_base_t() : buf(0) {}
-  ~csv_reader_base_t() { delete[] buf; }
-  void process_keys(bool eof);
-  void process(bool eof);
+  void start();
+  void stop();
 
 public:
-  void reinit(int more_passes = 0) { reinit_state(); this->reinit_output_if(more_passes); }
-  void reinit_state(int more_passes = 0) { line = 0; num_keys = 0; column = 0; this->reinit_output_state_if(more_passes); }
-  int run();
+  read_ahead_reader_t() : buf_count(4), buf_size(1024 * 1024), thread_created(0) {}
+  ~read_ahead_reader_t() { stop(); for(vector<char*>::iterator i = bufs.begin(); i != bufs.end(); ++i) delete[] *i; }
+  void set_read_ahead(size_t buf_count, size_t buf_size);
+  const char* next_buffer(size_t& len); //hands out the next ring buffer in place, it stays valid until the next call, 0 at the end
+  ssize_t read(void* buf, size_t len);
 };
 
-template<typename out_t> class csv_reader : public csv_reader_base_t<console_reader_t, single_output_pass_class_t<out_t> >
+#ifdef TABLE_ZLIB
+class gzip_file_reader_t //also reads concatenated gzip members and uncompressed files
 {
+  gzip_file_reader_t(const gzip_file_reader_t& other);
+  gzip_file_reader_t& operator=(const gzip_file_reader_t& other);
+
+  gzFile f;
+
 public:
-  void set_fd(int fd) { this->r.set_fd(fd); }
+  gzip_file_reader_t() : f(0) {}
+  ~gzip_file_reader_t() { if(f) gzclose(f); }
+  void open(const char* path) { if(f) close(); f = gzopen(path, "rb"); if(!f) throw runtime_error("can't open input file"); gzbuffer(f, 128 * 1024); }
+  ssize_t read(void* buf, size_t len) { int num_read = gzread(f, buf, unsigned(min(len, size_t(1 << 30)))); if(num_read < 0) throw runtime_error("couldn't decompress"); return num_read; }
+  void close() { if(f && gzclose(f) != Z_OK) throw runtime_error("can't close input file"); f = 0; }
 };
+#endif
 
-template<typename out_t> class csv_file_reader : public csv_reader_base_t<file_reader_t, single_output_pass_class_t<out_t> >
+#ifdef TABLE_ZSTD
+class zstd_file_reader_t
 {
+  zstd_file_reader_t(const zstd_file_reader_t& other);
+  zstd_file_reader_t& operator=(const zstd_file_reader_t& other);
+
+  file_reader_t f;
+  ZSTD_DStream* ds;
+  char* in_buf;
+  size_t in_cap;
+  ZSTD_inBuffer in;
+  size_t frame_left;
+  bool in_eof;
+
 public:
-  void open(const char* path) { this->r.open(path); }
-  void close() { this->r.close(); }
+  zstd_file_reader_t() : ds(0), in_buf(0), in_cap(0) {}
+  ~zstd_file_reader_t() { if(ds) ZSTD_freeDStream(ds); delete[] in_buf; }
+  void open(const char* path);
+  ssize_t read(void* buf, size_t len);
+  void close() { f.close(); }
 };
+#endif
 
+//reads files one after another as one stream, every header after the first is checked and dropped
+//a file is only opened once the one before it runs out, in a read_ahead_reader_t that happens on its thread like any other read
+class multi_file_reader_t
+{
+  multi_file_reader_t(const multi_file_reader_t& other);
+  multi_file_reader_t& operator=(const multi_file_reader_t& other);
 
-////////////////////////////////////////////////////////////////////////////////////////////////
+  file_reader_t f;
+  vector<string> paths;
+  size_t next_path;
+  bool file_open;
+  bool have_header;
+  string header_path;
+  vector<string> keys;
+  char delim;
+  char quote;
+  string pending;
+  size_t pending_off;
+  char last;
+
+  void open_next();
+  bool split_header(size_t begin, bool eof, size_t& end, vector<string>& file_keys) const;
+
+public:
+  multi_file_reader_t() : next_path(0), file_open(0), have_header(0), delim(','), quote('"'), pending_off(0), last('\n') {}
+  void set_delim(char delim, char quote) { this->delim = delim; this->quote = quote; } //how headers are split into keys to compare them
+  void add_file(const char* path) { paths.push_back(path); }
+  void add_glob(const char* pattern); //sorted matches, on windows only the last path component can have wildcards
+  void clear() { if(file_open) f.close(); paths.clear(); next_path = 0; file_open = 0; have_header = 0; pending.clear(); pending_off = 0; last = '\n'; }
+  ssize_t read(void* buf, size_t len);
+};
+
+class mmap_file_reader_t
+{
+  mmap_file_reader_t(const mmap_file_reader_t& other);
+  mmap_file_reader_t& operator=(const mmap_file_reader_t& other);
+#ifdef _WIN32
+  HANDLE h;
+  HANDLE m;
+#else
+  int fd;
+#endif
+  char* data;
+  size_t size;
+
+public:
+#ifdef _WIN32
+  mmap_file_reader_t() : h(INVALID_HANDLE_VALUE), m(NULL), data(0), size(0) {}
+  ~mmap_file_reader_t() { if(data) UnmapViewOfFile(data); if(m) CloseHandle(m); if(h != INVALID_HANDLE_VALUE) CloseHandle(h); }
+  void open(const char* path) {
+    if(h != INVALID_HANDLE_VALUE) close();
+    h = CreateFile(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL); if(h == INVALID_HANDLE_VALUE) throw runtime_error("can't open input file");
+    LARGE_INTEGER s; if(!GetFileSizeEx(h, &s)) throw runtime_error("can't size input file");
+    size = s.QuadPart; if(!size) return;
+    m = CreateFileMapping(h, NULL, PAGE_READONLY, 0, 0, NULL); if(!m) throw runtime_error("can't map input file");
+    data = static_cast<char*>(MapViewOfFile(m, FILE_MAP_READ, 0, 0, 0)); if(!data) throw runtime_error("can't map input file");
+  }
+  void close() {
+    if(data && !UnmapViewOfFile(data)) throw runtime_error("can't unmap input file");
+    data = 0; size = 0;
+    if(m && !CloseHandle(m)) throw runtime_error("can't close input file");
+    m = NULL;
+    if(h != INVALID_HANDLE_VALUE && !CloseHandle(h)) throw runtime_error("can't close input file");
+    h = INVALID_HANDLE_VALUE;
+  }
+#else
+  mmap_file_reader_t() : fd(-1), data(0), size(0) {}
+  ~mmap_file_reader_t() { if(data) munmap(data, size); if(fd >= 0) ::close(fd); }
+  void open(const char* path) {
+    if(fd >= 0) close();
+    fd = ::open(path, O_RDONLY | O_BINARY); if(fd < 0) throw runtime_error("can't open input file");
+    struct stat st; if(fstat(fd, &st)) throw runtime_error("can't stat input file");
+    size = st.st_size; if(!size) return;
+    //read only and faulted in as the parse gets there, MAP_POPULATE would read the whole file before the first token
+    void* p = mmap(0, size, PROT_READ, MAP_PRIVATE, fd, 0); if(p == MAP_FAILED) { size = 0; throw runtime_error("can't map input file"); }
+    data = static_cast<char*>(p);
+#ifdef MADV_SEQUENTIAL
+    madvise(data, size, MADV_SEQUENTIAL);
+#endif
+  }
+  void close() {
+    if(data && munmap(data, size)) throw runtime_error("can't unmap input file");
+    data = 0; size = 0;
+    if(fd >= 0 && ::close(fd)) throw runtime_error("can't close input file");
+    fd = -1;
+  }
+#endif
+  const char* begin() const { return data; }
+  const char* end() const { return data + size; }
+};
+
+struct comma_delim_t { static const char delim = ','; static const char quote = '"'; };
+struct tab_delim_t { static const char delim = '\t'; static const char quote = '\0'; }; //no quoting, as for text/tab-separated-values
+struct pipe_delim_t { static const char delim = '|'; static const char quote = '"'; };
+
+template<char delim, char quote = '\0'> class delim_scanner_t //finds the next delim, '\n' or quote if there is one, keeping a 64 byte delimiter bitmask between calls
+{
+#if defined(__AVX2__) || defined(__SSE2__)
+  const char* block;
+  uint64_t mask;
+
+#if defined(__AVX2__)
+  static uint64_t delim_mask(const char* p) {
+    const __m256i nl = _mm256_set1_epi8('\n');
+    const __m256i d = _mm256_set1_epi8(delim);
+    __m256i lo = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+    __m256i hi = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 32));
+    __m256i mlo = _mm256_or_si256(_mm256_cmpeq_epi8(lo, nl), _mm256_cmpeq_epi8(lo, d));
+    __m256i mhi = _mm256_or_si256(_mm256_cmpeq_epi8(hi, nl), _mm256_cmpeq_epi8(hi, d));
+    if(quote) {
+      const __m256i q = _mm256_set1_epi8(quote);
+      mlo = _mm256_or_si256(mlo, _mm256_cmpeq_epi8(lo, q));
+      mhi = _mm256_or_si256(mhi, _mm256_cmpeq_epi8(hi, q));
+    }
+    return uint64_t(uint32_t(_mm256_movemask_epi8(mlo))) | (uint64_t(uint32_t(_mm256_movemask_epi8(mhi))) << 32);
+  }
+#else
+  static uint64_t delim_mask(const char* p) {
+    const __m128i nl = _mm_set1_epi8('\n');
+    const __m128i d = _mm_set1_epi8(delim);
+    const __m128i q = _mm_set1_epi8(quote);
+    uint64_t m = 0;
+    for(int i = 0; i < 4; ++i) {
+      __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i * 16));
+      __m128i e = _mm_or_si128(_mm_cmpeq_epi8(v, nl), _mm_cmpeq_epi8(v, d));
+      if(quote) e = _mm_or_si128(e, _mm_cmpeq_epi8(v, q));
+      m |= uint64_t(uint16_t(_mm_movemask_epi8(e))) << (i * 16);
+    }
+    return m;
+  }
+#endif
+
+public:
+  delim_scanner_t() : block(0), mask(0) {}
+  const char* find(const char* p, const char* end) {
+    if(block && p >= block && p < block + 64) {
+      mask &= ~uint64_t(0) << (p - block);
+      if(mask) return block + __builtin_ctzll(mask);
+      p = block + 64;
+    }
+    for(; p + 64 <= end; p += 64) {
+      mask = delim_mask(p);
+      if(mask) { block = p; return p + __builtin_ctzll(mask); }
+    }
+    block = 0;
+    while(p < end && *p != '\n' && *p != delim && (!quote || *p != quote)) ++p;
+    return p;
+  }
+#else
+public:
+  const char* find(const char* p, const char* end) {
+    while(p < end && *p != '\n' && *p != delim && (!quote || *p != quote)) ++p;
+    return p;
+  }
+#endif
+};
+
+typedef delim_scanner_t<','> csv_delim_scanner_t;
+
+class csv_parallel_scanner_t //parses newline aligned chunks into row blocks on worker threads, handed back in file order
+{
+  csv_parallel_scanner_t(const csv_parallel_scanner_t& other);
+  csv_parallel_scanner_t& operator=(const csv_parallel_scanner_t& other);
+
+public:
+  struct chunk_t {
+    const char* begin;
+    const char* end;
+    const char* tail; //where the parse stopped, end unless a quoted field runs past it or a line is bad
+    size_t lines; //newlines before tail
+    string error; //the message for the line at tail without its line number, empty if there isn't one
+    row_block_t block;
+    vector<char> unescaped; //reserved to the chunk size before the first field goes in, so block can point into it
+    size_t ready; //chunk index + 1 once parsed
+  };
+  typedef void (*parse_t)(const void* context, chunk_t& chunk);
+
+protected:
+  struct worker_t {
+    csv_parallel_scanner_t* s;
+    size_t id;
+    pthread_t thread;
+  };
+  static void* worker_main(void* data);
+  const char* chunk_begin(size_t chunk);
+
+  parse_t parse;
+  const void* context;
+
+  const char* begin;
+  const char* end;
+  size_t chunk_size;
+  size_t num_chunks;
+  vector<chunk_t> chunks;
+  vector<worker_t> workers;
+  size_t consumed;
+  bool have_current;
+  bool abort;
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+
+public:
+  csv_parallel_scanner_t() : num_chunks(0), consumed(0), have_current(0), abort(0) {}
+  ~csv_parallel_scanner_t() { stop(); }
+  void start(const char* begin, const char* end, size_t threads, size_t chunk_size, parse_t parse, const void* context);
+  const chunk_t* next(); //0 after the last chunk, a chunk stays valid until the next call
+  void stop();
+};
+
+template<typename reader_t, typename output_base_t, typename delim_t = comma_delim_t> class csv_reader_base_t : public output_base_t
+{
+  csv_reader_base_t(const csv_reader_base_t<reader_t, output_base_t, delim_t>& other);
+  csv_reader_base_t& operator=(const csv_reader_base_t<reader_t, output_base_t, delim_t>& other);
+
+protected:
+  reader_t r;
+  size_t line;
+  size_t num_keys;
+  size_t column;
+  char* buf;
+  const char* start;
+  const char* data_end;
+  char* buf_end;
+  bool in_keys;
+  vector<char> unescaped; //quoted fields with "" in them, the input itself is never written
+
+  //per column handling, empty when every column is output as a string token
+  enum column_mode_e { CM_TOKEN, CM_SKIP, CM_NUMBER, CM_SAMPLE, CM_SAMPLE_TEXT };
+  vector<char> column_modes;
+  size_t infer_rows;
+  size_t sample_rows_left;
+  set<string> string_keys;
+  vector<bool> string_columns;
+
+  //rows for a dynamic_pass_t out are handed over a block at a time, a block is flushed before carry moves the buffer
+  row_block_t block;
+  size_t block_rows;
+
+  csv_reader_base_t() : buf(0), infer_rows(0), block_rows(1024) {}
+  ~csv_reader_base_t() { delete[] buf; }
+  static const char* quoted_end(const char* start, const char* end, bool eof, bool& escaped, bool& bad);
+  static void unescape(const char* start, const char* end, vector<char>& to) { for(const char* i = start + 1; i != end - 1; ++i) { to.push_back(*i); if(*i == delim_t::quote) ++i; } }
+  const char* quoted_token(bool eof, const char*& token, size_t& len);
+  void carry();
+  void output_key(const char* token, size_t len);
+  void output_keys();
+  void output_token(const char* token, size_t len) { if(output_base_t::block_output && block_rows) block.add_token(token, len); else output_base_t::output_token(token, len); }
+  void output_token(double token) { if(output_base_t::block_output && block_rows) block.add_token(token); else output_base_t::output_token(token); }
+  void output_null() { if(output_base_t::block_output && block_rows) block.add_null(); else output_base_t::output_null(); }
+  void output_line() { if(output_base_t::block_output && block_rows) { block.add_line(); if(block.lines() >= block_rows) flush_block(); } else output_base_t::output_line(); }
+  void flush_block() { if(!block.empty()) { this->output_block(block); block.clear(); } unescaped.clear(); }
+  void output_column(const char* token, size_t len);
+  void end_sample();
+  void process_keys(bool eof);
+  const char* find_end(delim_scanner_t<delim_t::delim, delim_t::quote>& scanner, const char* p) { //a quote inside an unquoted token is kept as text
+    const char* end = scanner.find(p, data_end);
+    while(delim_t::quote && end != data_end && *end == delim_t::quote) end = scanner.find(end + 1, data_end);
+    return end;
+  }
+  template<bool per_column> void process_tokens(bool eof);
+  void process(bool eof);
+  void process_range(const char* b, const char* b_end);
+  void add_column(row_block_t& to, size_t column, const char* token, size_t len) const;
+  static void parse_chunk(const void* context, csv_parallel_scanner_t::chunk_t& ch);
+  template<typename from_t> void read_from(from_t& from);
+  template<typename from_t> void read_from(read_ahead_reader_t<from_t>& from);
+  int run_mapped(const char* begin, const char* end, size_t threads = 1, size_t chunk_size = 1024 * 1024);
+
+public:
+  void reinit(int more_passes = 0) { reinit_state(); this->reinit_output_if(more_passes); }
+  void reinit_state(int more_passes = 0) { line = 0; num_keys = 0; column = 0; block.clear(); this->reinit_output_state_if(more_passes); }
+  void set_infer_numeric(size_t sample_rows) { infer_rows = sample_rows; } //0 turns inference off
+  void set_block_rows(size_t rows) { block_rows = rows; } //1024 by default, 0 makes per token calls to a dynamic_pass_t
+  void add_string_column(const char* key) { string_keys.insert(key); }
+  int run();
+};
+
+template<typename out_t, typename delim_t = comma_delim_t> class csv_reader : public csv_reader_base_t<console_reader_t, single_output_pass_class_t<out_t>, delim_t>
+{
+public:
+  void set_fd(int fd) { this->r.set_fd(fd); }
+};
+
+template<typename out_t, typename delim_t = comma_delim_t> class csv_file_reader : public csv_reader_base_t<file_reader_t, single_output_pass_class_t<out_t>, delim_t>
+{
+public:
+  void open(const char* path) { this->r.open(path); }
+  void close() { this->r.close(); }
+};
+
+template<typename out_t, typename delim_t = comma_delim_t> class csv_read_ahead_reader : public csv_reader_base_t<read_ahead_reader_t<console_reader_t>, single_output_pass_class_t<out_t>, delim_t>
+{
+public:
+  void set_fd(int fd) { this->r.set_fd(fd); }
+  void set_read_ahead(size_t buf_count, size_t buf_size) { this->r.set_read_ahead(buf_count, buf_size); }
+};
+
+template<typename out_t, typename delim_t = comma_delim_t> class csv_read_ahead_file_reader : public csv_reader_base_t<read_ahead_reader_t<file_reader_t>, single_output_pass_class_t<out_t>, delim_t>
+{
+public:
+  void open(const char* path) { this->r.open(path); }
+  void close() { this->r.close(); }
+  void set_read_ahead(size_t buf_count, size_t buf_size) { this->r.set_read_ahead(buf_count, buf_size); }
+};
+
+#ifdef TABLE_ZLIB
+template<typename out_t, typename delim_t = comma_delim_t> class csv_gzip_file_reader : public csv_reader_base_t<read_ahead_reader_t<gzip_file_reader_t>, single_output_pass_class_t<out_t>, delim_t>
+{
+public:
+  void open(const char* path) { this->r.open(path); }
+  void close() { this->r.close(); }
+  void set_read_ahead(size_t buf_count, size_t buf_size) { this->r.set_read_ahead(buf_count, buf_size); }
+};
+#endif
+
+#ifdef TABLE_ZSTD
+template<typename out_t, typename delim_t = comma_delim_t> class csv_zstd_file_reader : public csv_reader_base_t<read_ahead_reader_t<zstd_file_reader_t>, single_output_pass_class_t<out_t>, delim_t>
+{
+public:
+  void open(const char* path) { this->r.open(path); }
+  void close() { this->r.close(); }
+  void set_read_ahead(size_t buf_count, size_t buf_size) { this->r.set_read_ahead(buf_count, buf_size); }
+};
+#endif
+
+template<typename out_t, typename delim_t = comma_delim_t> class csv_multi_file_reader : public csv_reader_base_t<read_ahead_reader_t<multi_file_reader_t>, single_output_pass_class_t<out_t>, delim_t>
+{
+public:
+  csv_multi_file_reader() { this->r.set_delim(delim_t::delim, delim_t::quote); }
+  void add_file(const char* path) { this->r.add_file(path); }
+  void add_glob(const char* pattern) { this->r.add_glob(pattern); }
+  void clear() { this->r.clear(); }
+  void set_read_ahead(size_t buf_count, size_t buf_size) { this->r.set_read_ahead(buf_count, buf_size); }
+};
+
+template<typename out_t, typename delim_t = comma_delim_t> class csv_mmap_file_reader : public csv_reader_base_t<mmap_file_reader_t, single_output_pass_class_t<out_t>, delim_t>
+{
+  size_t threads;
+  size_t chunk_size;
+
+public:
+  csv_mmap_file_reader() : threads(1), chunk_size(1024 * 1024) {}
+  void open(const char* path) { this->r.open(path); }
+  void close() { this->r.close(); }
+  void set_threads(size_t threads, size_t chunk_size = 1024 * 1024) { if(!threads || !chunk_size) throw runtime_error("invalid thread setup"); this->threads = threads; this->chunk_size = chunk_size; }
+  int run() { return this->run_mapped(this->r.begin(), this->r.end(), threads, chunk_size); }
+};
+
+template<typename reader_t, typename output_base_t> class fixed_width_reader_base_t : public output_base_t //slices records at fixed column widths, no header
+{
+  fixed_width_reader_base_t(const fixed_width_reader_base_t<reader_t, output_base_t>& other);
+  fixed_width_reader_base_t& operator=(const fixed_width_reader_base_t<reader_t, output_base_t>& other);
+
+protected:
+  reader_t r;
+  vector<string> keys;
+  vector<size_t> widths;
+  vector<char> skip;
+  size_t record_len;
+  bool newline;
+  bool trim;
+  size_t line;
+  char* buf;
+  char* buf_end;
+  vector<char> field; //each field is copied here and ended with a '\0', nothing after it would stop a strtod that ignores len
+
+  fixed_width_reader_base_t() : record_len(0), newline(1), trim(1), line(0), buf(0) {}
+  ~fixed_width_reader_base_t() { delete[] buf; }
+  void process_record(const char* record);
+
+public:
+  void reinit(int more_passes = 0) { reinit_state(); this->reinit_output_if(more_passes); }
+  void reinit_state(int more_passes = 0) { line = 0; this->reinit_output_state_if(more_passes); }
+  void add_column(const char* key, size_t width) { if(!width) throw runtime_error("invalid column width"); keys.push_back(key); widths.push_back(width); record_len += width; }
+  void set_newline(bool newline) { this->newline = newline; } //records are followed by '\n', the last one may leave it off
+  void set_trim(bool trim) { this->trim = trim; } //drop trailing spaces from each field
+  int run();
+};
+
+template<typename out_t> class fixed_width_reader : public fixed_width_reader_base_t<console_reader_t, single_output_pass_class_t<out_t> >
+{
+public:
+  void set_fd(int fd) { this->r.set_fd(fd); }
+};
+
+template<typename out_t> class fixed_width_file_reader : public fixed_width_reader_base_t<file_reader_t, single_output_pass_class_t<out_t> >
+{
+public:
+  void open(const char* path) { this->r.open(path); }
+  void close() { this->r.close(); }
+};
+
+template<typename reader_t> class record_reader_t : public reader_t //buffers reader_t so a whole record can be looked at once it has been filled
+{
+  record_reader_t(const record_reader_t<reader_t>& other);
+  record_reader_t& operator=(const record_reader_t<reader_t>& other);
+
+  char* buf;
+  char* buf_end;
+  char* data_end;
+
+public:
+  const char* next;
+
+  record_reader_t() : buf(0), buf_end(0), data_end(0), next(0) {}
+  ~record_reader_t() { delete[] buf; }
+  void reset() { if(!buf) { buf = new char[64 * 1024]; buf_end = buf + 64 * 1024; } next = data_end = buf; }
+  bool fill(size_t len); //false if the input ends first
+  bool skip(size_t len);
+  bool read_len(size_t& len); //a little endian base 128 varint
+};
+
+template<typename reader_t, typename output_base_t> class binary_reader_base_t : public output_base_t //reads what basic_binary_writer_t writes, stops at the end of the first stream
+{
+  binary_reader_base_t(const binary_reader_base_t<reader_t, output_base_t>& other);
+  binary_reader_base_t& operator=(const binary_reader_base_t<reader_t, output_base_t>& other);
+
+protected:
+  record_reader_t<reader_t> r;
+
+  binary_reader_base_t() {}
+
+public:
+  void reinit(int more_passes = 0) { reinit_state(); this->reinit_output_if(more_passes); }
+  void reinit_state(int more_passes = 0) { this->reinit_output_state_if(more_passes); }
+  int run();
+};
+
+template<typename out_t> class binary_reader : public binary_reader_base_t<console_reader_t, single_output_pass_class_t<out_t> >
+{
+public:
+  void set_fd(int fd) { this->r.set_fd(fd); }
+};
+
+template<typename out_t> class binary_file_reader : public binary_reader_base_t<file_reader_t, single_output_pass_class_t<out_t> >
+{
+public:
+  void open(const char* path) { this->r.open(path); }
+  void close() { this->r.close(); }
+};
+
+template<typename reader_t, typename output_base_t> class columnar_reader_base_t : public output_base_t //reads what basic_columnar_writer_t writes, blocks that the ranges rule out aren't decompressed
+{
+  columnar_reader_base_t(const columnar_reader_base_t<reader_t, output_base_t>& other);
+  columnar_reader_base_t& operator=(const columnar_reader_base_t<reader_t, output_base_t>& other);
+
+protected:
+  struct range_t { string key; size_t column; double min; double max; };
+  struct block_column_t { size_t numbers; size_t nulls; size_t distinct; double min; double max; char codec; size_t raw_len; size_t stored_len; };
+  struct cell_t { char tag; double value; const char* token; size_t len; };
+
+  record_reader_t<reader_t> r;
+  vector<range_t> ranges;
+  size_t blocks_read;
+  size_t blocks_skipped;
+
+  columnar_reader_base_t() : blocks_read(0), blocks_skipped(0) {}
+  bool read_len(size_t& len) { if(!r.read_len(len)) throw runtime_error("truncated columnar stream"); return 1; }
+
+public:
+  void reinit(int more_passes = 0) { reinit_state(); this->reinit_output_if(more_passes); }
+  void reinit_state(int more_passes = 0) { this->reinit_output_state_if(more_passes); }
+  void add_range(const char* key, double min, double max) { range_t range; range.key = key; range.min = min; range.max = max; ranges.push_back(range); } //only rows with a number in [min, max] in the column are output
+  size_t get_blocks_read() const { return blocks_read; }
+  size_t get_blocks_skipped() const { return blocks_skipped; }
+  int run();
+};
+
+template<typename out_t> class columnar_reader : public columnar_reader_base_t<console_reader_t, single_output_pass_class_t<out_t> >
+{
+public:
+  void set_fd(int fd) { this->r.set_fd(fd); }
+};
+
+template<typename out_t> class columnar_file_reader : public columnar_reader_base_t<file_reader_t, single_output_pass_class_t<out_t> >
+{
+public:
+  void open(const char* path) { this->r.open(path); }
+  void close() { this->r.close(); }
+};
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////
 // threader
 ////////////////////////////////////////////////////////////////////////////////////////////////
 
@@ -564,29 +1766,44 @@ protected:
   };
   static void* threader_main(void* data);
 
-  chunk_info_t chunks[8];
+  //a single producer single consumer ring, each side publishes its index and only takes the lock to sleep or wake a sleeper
+  vector<chunk_info_t> chunks;
+  size_t chunk_size;
   size_t write_chunk;
   char* write_chunk_next;
   size_t read_chunk;
+  int prod_waiting;
+  int cons_waiting;
   bool thread_created;
   pthread_mutex_t mutex;
   pthread_cond_t prod_cond;
   pthread_cond_t cons_cond;
   pthread_t thread;
+  row_block_t out_block; //the consumer's rows from the chunk it's reading, for a dynamic_pass_t out
 
   basic_threader_t();
   ~basic_threader_t();
+  void alloc_chunks();
   void resize_write_chunk(size_t min_size);
   void inc_write_chunk(bool term = 1);
+  void wait_while(const size_t& index, size_t value, pthread_cond_t& cond, int& waiting);
+  void wake(pthread_cond_t& cond, int& waiting) { if(__atomic_load_n(&waiting, __ATOMIC_SEQ_CST)) { pthread_mutex_lock(&mutex); pthread_cond_signal(&cond); pthread_mutex_unlock(&mutex); } }
+  void flush_out_block() { if(!out_block.empty()) { this->output_block(out_block); out_block.clear(); } }
+  void create_thread();
 
 public:
+  void set_chunks(size_t count, size_t size); //8 chunks of 8KB by default, a chunk grows to fit a token that doesn't
   void reinit(int more_passes = 0) { reinit_state(); this->reinit_output_if(more_passes); }
   void reinit_state(int more_passes = 0);
+  const vector<bool>* get_skip_columns();
   void process_key(const char* token, size_t len);
   void process_keys();
   void process_token(const char* token, size_t len);
   void process_token(double token);
+  void process_token(int64_t token);
+  void process_null();
   void process_line();
+  void process_block(const row_block_t& block);
   void process_stream();
 };
 
@@ -596,6 +1813,113 @@ class dynamic_output_threader : public basic_threader_t<empty_pass_t, single_out
 class dynamic_output_dynamic_threader : public basic_threader_t<dynamic_pass_t, single_output_pass_class_t<dynamic_pass_t*> > {};
 
 
+////////////////////////////////////////////////////////////////////////////////////////////////
+// parallel_map
+////////////////////////////////////////////////////////////////////////////////////////////////
+
+class row_buffer_t //a pass that records what it's given so it can be replayed into another
+{
+public:
+  vector<char> buf;
+
+  const vector<bool>* get_skip_columns() { return 0; }
+  void reinit(int more_passes = 0) { buf.clear(); }
+  void reinit_state(int more_passes = 0) { buf.clear(); }
+  void process_key(const char* token, size_t len) { put('k', token, len); }
+  void process_keys() { buf.push_back('K'); }
+  void process_token(const char* token, size_t len) { put('s', token, len); }
+  void process_token(double token) { buf.push_back('d'); buf.insert(buf.end(), reinterpret_cast<const char*>(&token), reinterpret_cast<const char*>(&token) + sizeof(double)); }
+  void process_token(int64_t token) { buf.push_back('i'); buf.insert(buf.end(), reinterpret_cast<const char*>(&token), reinterpret_cast<const char*>(&token) + sizeof(int64_t)); }
+  void process_null() { buf.push_back('n'); }
+  void process_line() { buf.push_back('l'); }
+  void process_stream() {}
+  template<typename pass_t> void replay(pass_t& out) const;
+
+private:
+  void put(char tag, const char* token, size_t len) {
+    buf.push_back(tag);
+    buf.insert(buf.end(), reinterpret_cast<const char*>(&len), reinterpret_cast<const char*>(&len) + sizeof(size_t));
+    buf.insert(buf.end(), token, token + len);
+  }
+};
+
+template<typename input_base_t, typename output_base_t, template<typename> class pass_t> class basic_parallel_map_t : public input_base_t, public output_base_t //runs batches of lines through N copies of a stateless pass, the output stays in input order
+{
+  basic_parallel_map_t(const basic_parallel_map_t<input_base_t, output_base_t, pass_t>& other);
+  basic_parallel_map_t& operator=(const basic_parallel_map_t<input_base_t, output_base_t, pass_t>& other);
+
+protected:
+  enum worker_state_e { WS_IDLE, WS_QUEUED, WS_DONE };
+  struct worker_t {
+    pass_t<row_buffer_t> pass;
+    row_buffer_t in;
+    worker_state_e state;
+    bool quit;
+    bool error;
+    string error_msg;
+    bool thread_created;
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t job_cond;
+    pthread_cond_t done_cond;
+
+    worker_t() : state(WS_IDLE), quit(0), error(0), thread_created(0) { pthread_mutex_init(&mutex, 0); pthread_cond_init(&job_cond, 0); pthread_cond_init(&done_cond, 0); }
+    ~worker_t() { pthread_cond_destroy(&done_cond); pthread_cond_destroy(&job_cond); pthread_mutex_destroy(&mutex); }
+  };
+  static void* worker_main(void* data);
+
+  //the output adapter that row_buffer_t::replay forwards into
+  struct output_t {
+    basic_parallel_map_t& m;
+    output_t(basic_parallel_map_t& m) : m(m) {}
+    void process_key(const char* token, size_t len) { m.output_key(token, len); }
+    void process_keys() { m.output_keys(); }
+    void process_token(const char* token, size_t len) { m.output_token(token, len); }
+    void process_token(double token) { m.output_token(token); }
+    void process_token(int64_t token) { m.output_token(token); }
+    void process_null() { m.output_null(); }
+    void process_line() { m.output_line(); }
+  };
+
+  vector<worker_t*> workers;
+  void (*configure)(pass_t<row_buffer_t>& pass, size_t worker, void* data);
+  void* configure_data;
+  bool handed_out; //get_worker gave a copy out to be set up by hand
+  row_buffer_t batch;
+  size_t batch_rows;
+  size_t rows;
+  size_t next_batch;
+  size_t next_output;
+
+  void dispatch();
+  void collect(worker_t& w);
+  void stop_workers();
+
+public:
+  basic_parallel_map_t();
+  ~basic_parallel_map_t() { stop_workers(); for(typename vector<worker_t*>::iterator i = workers.begin(); i != workers.end(); ++i) delete *i; }
+  void set_workers(size_t count); //one per core by default, refused once get_worker has handed a copy out
+  void configure_workers(void (*configure)(pass_t<row_buffer_t>& pass, size_t worker, void* data), void* data = 0); //run on every copy now and on the ones set_workers makes
+  size_t get_worker_count() const { return workers.size(); }
+  pass_t<row_buffer_t>& get_worker(size_t i) { handed_out = 1; return workers[i]->pass; }
+  void set_batch_rows(size_t batch_rows) { if(!batch_rows) throw runtime_error("invalid batch rows"); this->batch_rows = batch_rows; }
+  const vector<bool>* get_skip_columns(); //every copy is asked so they all drop the same columns
+  void reinit(int more_passes = 0) { stop_workers(); for(typename vector<worker_t*>::iterator i = workers.begin(); i != workers.end(); ++i) (*i)->pass.reinit(); reinit_state(); this->reinit_output_if(more_passes); }
+  void reinit_state(int more_passes = 0);
+  void process_key(const char* token, size_t len) { for(typename vector<worker_t*>::iterator i = workers.begin(); i != workers.end(); ++i) (*i)->pass.process_key(token, len); }
+  void process_keys();
+  void process_token(const char* token, size_t len) { batch.process_token(token, len); }
+  void process_token(double token) { batch.process_token(token); }
+  void process_token(int64_t token) { batch.process_token(token); }
+  void process_null() { batch.process_null(); }
+  void process_line() { batch.process_line(); if(++rows == batch_rows) dispatch(); }
+  void process_stream();
+};
+
+template<template<typename> class pass_t, typename out_t> class parallel_map : public basic_parallel_map_t<empty_pass_t, single_output_pass_class_t<out_t>, pass_t> {};
+template<template<typename> class pass_t, typename out_t> class dynamic_parallel_map : public basic_parallel_map_t<dynamic_pass_t, single_output_pass_class_t<out_t>, pass_t> {};
+
+
 ////////////////////////////////////////////////////////////////////////////////////////////////
 // subset_tee
 ////////////////////////////////////////////////////////////////////////////////////////////////
@@ -673,6 +1997,8 @@ public:
   void process_keys();
   void process_token(const char* token, size_t len);
   void process_token(double token);
+  void process_token(int64_t token);
+  void process_null();
   void process_line();
   void process_stream();
 };
@@ -712,6 +2038,8 @@ protected:
   vector<string> stack_keys;
   vector<stack_action_e> actions;
   size_t last_leave;
+  vector<bool> skip_columns;
+  bool skipping; //the reader was told to skip the removed columns, so process_keys renumbers over the rest
 
   //current line information
   size_t column;
@@ -723,7 +2051,7 @@ protected:
   size_t stack_tokens_index;
   char* stack_tokens_next;
 
-  basic_stacker_t() : default_action(ST_REMOVE), last_leave(0), column(0), stack_column(0), leave_tokens_index(0), leave_tokens_next(0), stack_tokens_index(0), stack_tokens_next(0) {}
+  basic_stacker_t() : default_action(ST_REMOVE), last_leave(0), skipping(0), column(0), stack_column(0), leave_tokens_index(0), leave_tokens_next(0), stack_tokens_index(0), stack_tokens_next(0) {}
   ~basic_stacker_t();
   void resize(size_t len, vector<pair<char*, char*> >& tokens, size_t& index, char*& next);
   void process_leave_tokens();
@@ -736,6 +2064,7 @@ public:
   void add_action(bool regex, const char* key, stack_action_e action);
   void process_key(const char* token, size_t len);
   void process_keys();
+  const vector<bool>* get_skip_columns();
   void process_token(const char* token, size_t len);
   void process_token(double token);
   void process_line();
@@ -810,6 +2139,7 @@ public:
   void process_key(const char* token, size_t len);
   void process_keys();
   void process_token(const char* token, size_t len);
+  void process_token(double token) { char buf[32]; size_t len = dtostr(token, buf); process_token(buf, len); }
   void process_line();
   void process_stream();
 };
@@ -872,6 +2202,7 @@ public:
   void process_key(const char* token, size_t len);
   void process_keys();
   void process_token(const char* token, size_t len);
+  void process_token(double token) { char buf[32]; size_t len = dtostr(token, buf); process_token(buf, len); }
   void process_line();
   void process_stream();
 };
@@ -909,7 +2240,7 @@ protected:
 
   vector<data_t> data;
 
-  basic_row_joiner_t() {}
+  basic_row_joiner_t() { reinit_state(); }
   ~basic_row_joiner_t();
 
 public:
@@ -920,6 +2251,8 @@ public:
   void process_keys();
   void process_token(const char* token, size_t len);
   void process_token(double token);
+  void process_token(int64_t token);
+  void process_null();
   void process_line() {}
   void process_stream();
   void process_lines();
@@ -1015,11 +2348,15 @@ protected:
 public:
   void reinit(int more_passes = 0) { reinit_state(); this->reinit_output_if(more_passes); }
   void reinit_state(int more_passes = 0);
+  const vector<bool>* get_skip_columns() { return 0; } //the out gets its keys once the empty columns are known, too late to be asked
   void process_key(const char* token, size_t len);
   void process_keys();
   void process_token(const char* token, size_t len);
   void process_token(double token);
+  void process_token(int64_t token);
+  void process_null();
   void process_line();
+  void process_block(const row_block_t& block);
   void process_stream();
 };
 
@@ -1102,10 +2439,13 @@ protected:
 
   vector<uint32_t> column_flags;
   size_t num_data_columns;
+  vector<bool> skip_columns;
+  bool skipping; //the reader was told to skip the unused columns, so process_keys drops their flags
 
   vector<uint32_t>::const_iterator cfi;
   double* values;
   double* vi;
+  vector<char> nulls; //the line's data columns that are missing, set without going through a NaN
   char* pre_sorted_group_tokens;
   char* pre_sorted_group_tokens_next;
   char* pre_sorted_group_tokens_end;
@@ -1138,8 +2478,11 @@ public:
   void add_exception(const char* regex);
   void process_key(const char* token, size_t len);
   void process_keys();
+  const vector<bool>* get_skip_columns();
   void process_token(const char* token, size_t len);
   void process_token(double token);
+  void process_token(int64_t token);
+  void process_null();
   void process_line();
   void process_stream() { print_data(); output_base_t::output_stream(); }
 };
@@ -1236,6 +2579,8 @@ public:
   void process_keys() { column = 0; this->output_keys(); }
   void process_token(const char* token, size_t len);
   void process_token(double token);
+  void process_token(int64_t token);
+  void process_null() { this->output_null(); ++column; }
   void process_line() { column = 0; this->output_line(); }
   void process_stream() { this->output_stream(); }
 };
@@ -1395,7 +2740,7 @@ protected:
   basic_unary_col_adder_t() : column(0), buf(new char[2048]), end(buf + 2048) {}
   ~basic_unary_col_adder_t() { for(typename vector<inst_t>::iterator i = insts.begin(); i != insts.end(); ++i) pcre_free((*i).regex); delete[] buf; }
   c_str_and_len_t get_in_value(const char* token, size_t len, c_str_and_len_t* dummy) { return c_str_and_len_t(token, len); }
-  c_str_and_len_t get_in_value(double token, char* buf, c_str_and_len_t* dummy) { c_str_and_len_t ret; ret.c_str = buf; ret.len = dtostr(token, buf); return ret; }
+  c_str_and_len_t get_in_value(double token, char* buf, c_str_and_len_t* dummy) { c_str_and_len_t ret; ret.c_str = buf; ret.len = dtostr(token, buf, 6); return ret; }
   double get_in_value(const char* token, size_t len, double* dummy) { char* next; double ret = strtod(token, &next); if(next == token) ret = numeric_limits<double>::quiet_NaN(); return ret; }
   double get_in_value(double token, char* buf, double* dummy) { return token; }
   using output_base_t::output_token;
@@ -1418,6 +2763,9 @@ template<typename out_t> class unary_c_str_col_adder : public basic_unary_col_ad
 template<typename out_t> class unary_double_c_str_col_adder : public basic_unary_col_adder_t<empty_pass_t, single_output_pass_class_t<out_t>, double, c_str_and_len_t, c_str_and_len_t (*)(double)> {};
 template<typename out_t> class unary_c_str_double_col_adder : public basic_unary_col_adder_t<empty_pass_t, single_output_pass_class_t<out_t>, c_str_and_len_t, double, double (*)(c_str_and_len_t)> {};
 template<typename out_t> class substitute_col_adder : public basic_unary_col_adder_t<empty_pass_t, single_output_pass_class_t<out_t>, c_str_and_len_t, c_str_and_len_t, substituter> {};
+template<typename out_t> class dynamic_substitute_col_adder : public basic_unary_col_adder_t<dynamic_pass_t, single_output_pass_class_t<out_t>, c_str_and_len_t, c_str_and_len_t, substituter> {};
+class dynamic_output_substitute_col_adder : public basic_unary_col_adder_t<empty_pass_t, single_output_pass_class_t<dynamic_pass_t*>, c_str_and_len_t, c_str_and_len_t, substituter> {};
+class dynamic_output_dynamic_substitute_col_adder : public basic_unary_col_adder_t<dynamic_pass_t, single_output_pass_class_t<dynamic_pass_t*>, c_str_and_len_t, c_str_and_len_t, substituter> {};
 
 
 ////////////////////////////////////////////////////////////////////////////////////////////////
@@ -1480,6 +2828,47 @@ template<typename out_t> class binary_double_c_str_col_adder : public basic_bina
 template<typename out_t> class binary_c_str_double_col_adder : public basic_binary_col_adder_t<empty_pass_t, single_output_pass_class_t<out_t>, c_str_and_len_t, c_str_and_len_t, double, double (*)(c_str_and_len_t, c_str_and_len_t)> {};
 
 
+////////////////////////////////////////////////////////////////////////////////////////////////
+// pass_chain
+////////////////////////////////////////////////////////////////////////////////////////////////
+
+//dynamic passes built from settings like "--sort -d LOT --stack -s DATA --prune", run in one process so nothing
+//between the stages is written out as csv and parsed again
+class pass_chain_t
+{
+  pass_chain_t(const pass_chain_t& other);
+  pass_chain_t& operator=(const pass_chain_t& other);
+
+protected:
+  enum stage_e { SG_STACK, SG_SPLIT, SG_SORT, SG_SUMMARIZE, SG_ADD, SG_PRUNE, SG_THREAD };
+  struct stage_t {
+    stage_e type;
+    dynamic_pass_t* in;
+    single_output_pass_class_t<dynamic_pass_t*>* out;
+  };
+
+  vector<stage_t> stages;
+  bool thread_stages;
+  bool linked;
+  int mode; //what the current stage's values are for, set by its dash options
+  bool option_used; //a value came after the last option
+  bool regex;
+  bool remove_source;
+  vector<string> add_args;
+
+  template<typename pass_t> pass_t* add_stage(stage_e type);
+  void add_option(const string& option);
+  void add_value(const char* val);
+
+public:
+  pass_chain_t() : thread_stages(0), linked(0), mode(0), option_used(0), regex(0), remove_source(0) {}
+  ~pass_chain_t();
+  void set_thread_stages(bool thread_stages) { this->thread_stages = thread_stages; } //a threader between every pair of stages
+  bool add_setting(arg_fetcher& af); //0 if af's current setting isn't a stage, a stage option or a stage value
+  dynamic_pass_t* link(dynamic_pass_t* out); //the pass to feed, out itself when there are no stages
+};
+
+
 }
 
 
@@ -1497,46 +2886,192 @@ namespace table {
 using namespace std;
 
 ////////////////////////////////////////////////////////////////////////////////////////////////
-// tabular_writer
+// pass
 ////////////////////////////////////////////////////////////////////////////////////////////////
 
-template<typename input_base_t, typename output_base_t> void basic_tabular_writer_t<input_base_t, output_base_t>::process_data()
+template<typename pass_t> void row_block_t::replay(pass_t& out) const
 {
-  if(!next) return;
+  size_t t = 0;
+  for(vector<size_t>::const_iterator l = line_ends.begin(); 1; ++l) {
+    const size_t end = l == line_ends.end() ? tokens.size() : *l;
+    for(; t < end; ++t) {
+      if(tokens[t]) out.process_token(tokens[t], lens[t]);
+      else if(lens[t] % 4 == BK_DOUBLE) out.process_token(values[lens[t] / 4]);
+      else if(lens[t] % 4 == BK_INT) out.process_token(ints[lens[t] / 4]);
+      else pass_null(out);
+    }
+    if(l == line_ends.end()) break;
+    out.process_line();
+  }
+}
 
-  *next++ = '\03';
 
-  size_t c = 0;
-  char buf[32];
-  for(; c < max_width.size(); ++c) {
-    int len = sprintf(buf, "c%zu", c);
-    size_t spaces = 1 + max_width[c] - len;
-    for(size_t i = 0; i < spaces; ++i) this->output(' '); 
-    this->output(buf, len);
+////////////////////////////////////////////////////////////////////////////////////////////////
+// writer
+////////////////////////////////////////////////////////////////////////////////////////////////
+
+template<typename writer_t> void* async_writer_t<writer_t>::async_writer_main(void* data)
+{
+  async_writer_t<writer_t>& w = *static_cast<async_writer_t<writer_t>*>(data);
+
+  while(1) {
+    pthread_mutex_lock(&w.mutex);
+    while(!w.filled && !w.done) pthread_cond_wait(&w.cons_cond, &w.mutex);
+    const bool stop = !w.filled;
+    pthread_mutex_unlock(&w.mutex);
+    if(stop) break;
+
+    bool error = 0;
+    string error_msg;
+    try { w.writer_t::write(w.bufs[w.read_buf], w.lens[w.read_buf]); }
+    catch(exception& e) { error = 1; error_msg = e.what(); }
+    catch(...) { error = 1; error_msg = "unable to write"; }
+
+    pthread_mutex_lock(&w.mutex);
+    w.read_buf = (w.read_buf + 1) % w.buf_count;
+    --w.filled;
+    if(error) { w.error = 1; w.error_msg = error_msg; }
+    pthread_cond_signal(&w.prod_cond);
+    pthread_mutex_unlock(&w.mutex);
+    if(error) break;
+  }
+
+  return 0;
+}
+
+template<typename writer_t> void async_writer_t<writer_t>::start()
+{
+  if(bufs.size() != buf_count) {
+    for(vector<char*>::iterator i = bufs.begin(); i != bufs.end(); ++i) delete[] *i;
+    bufs.clear();
+    for(size_t i = 0; i < buf_count; ++i) bufs.push_back(new char[buf_size]);
+  }
+  lens.resize(buf_count);
+  write_buf = 0;
+  next = bufs[0];
+  end = next + buf_size;
+  read_buf = 0;
+  filled = 0;
+  done = 0;
+  error = 0;
+  pthread_mutex_init(&mutex, 0);
+  pthread_cond_init(&prod_cond, 0);
+  pthread_cond_init(&cons_cond, 0);
+  if(pthread_create(&thread, 0, async_writer_t<writer_t>::async_writer_main, this)) {
+    pthread_cond_destroy(&cons_cond);
+    pthread_cond_destroy(&prod_cond);
+    pthread_mutex_destroy(&mutex);
+    next = end = 0;
+    throw runtime_error("can't create async writer thread");
+  }
+  thread_created = 1;
+}
+
+template<typename writer_t> void async_writer_t<writer_t>::hand_off()
+{
+  pthread_mutex_lock(&mutex);
+  lens[write_buf] = next - bufs[write_buf];
+  ++filled;
+  pthread_cond_signal(&cons_cond);
+  while(filled == buf_count && !error) pthread_cond_wait(&prod_cond, &mutex);
+  const bool error = this->error;
+  pthread_mutex_unlock(&mutex);
+  write_buf = (write_buf + 1) % buf_count;
+  next = bufs[write_buf];
+  end = next + buf_size;
+  if(error) throw runtime_error(error_msg);
+}
+
+template<typename writer_t> void async_writer_t<writer_t>::next_buf()
+{
+  if(!thread_created) start();
+  else hand_off();
+}
+
+template<typename writer_t> void async_writer_t<writer_t>::set_async(size_t buf_count, size_t buf_size)
+{
+  if(thread_created) throw runtime_error("can't change async buffers while writing");
+  if(buf_count < 2 || !buf_size) throw runtime_error("invalid async buffers");
+  for(vector<char*>::iterator i = bufs.begin(); i != bufs.end(); ++i) delete[] *i;
+  bufs.clear();
+  this->buf_count = buf_count;
+  this->buf_size = buf_size;
+}
+
+template<typename writer_t> void async_writer_t<writer_t>::write(const char* token, size_t len)
+{
+  while(len) {
+    if(next == end) next_buf();
+    const size_t n = min(len, size_t(end - next));
+    memcpy(next, token, n);
+    next += n; token += n; len -= n;
+  }
+}
+
+template<typename writer_t> void async_writer_t<writer_t>::flush()
+{
+  if(!thread_created) return;
+
+  pthread_mutex_lock(&mutex);
+  if(next != bufs[write_buf]) { lens[write_buf] = next - bufs[write_buf]; ++filled; }
+  next = end = 0;
+  done = 1;
+  pthread_cond_signal(&cons_cond);
+  pthread_mutex_unlock(&mutex);
+  pthread_join(thread, 0);
+  pthread_cond_destroy(&cons_cond);
+  pthread_cond_destroy(&prod_cond);
+  pthread_mutex_destroy(&mutex);
+  thread_created = 0;
+  if(error) throw runtime_error(error_msg);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+// tabular_writer
+////////////////////////////////////////////////////////////////////////////////////////////////
+
+template<typename input_base_t, typename output_base_t> void basic_tabular_writer_t<input_base_t, output_base_t>::process_data()
+{
+  sampled = 1;
+  if(max_width.empty()) return;
+
+  size_t widest = 0;
+  for(vector<size_t>::const_iterator i = max_width.begin(); i != max_width.end(); ++i) widest = max(widest, *i);
+  pad.assign(widest + 1, ' ');
+
+  size_t c = 0;
+  char buf[32];
+  for(; c < max_width.size(); ++c) {
+    int len = sprintf(buf, "c%zu", c);
+    this->output(pad.data(), 1 + max_width[c] - len);
+    this->output(buf, len);
   }
   this->output('\n');
 
+  if(next) { const size_t end_len = size_t(-1); memcpy(next, &end_len, sizeof(size_t)); }
   c = 0;
   for(vector<char*>::iterator i = data.begin(); i != data.end(); ++i) {
-    next = *i;
-    while(*next != '\03') {
-      size_t len = strlen(next);
-      size_t spaces = 1 + max_width[c] - len;
-      for(size_t i = 0; i < spaces; ++i) this->output(' ');
+    for(next = *i; 1;) {
+      size_t len; memcpy(&len, next, sizeof(size_t)); next += sizeof(size_t);
+      if(len == size_t(-1)) break;
+      this->output(pad.data(), 1 + max_width[c] - len);
       this->output(next, len);
-      next += len + 1;
+      next += len;
       if(++c >= max_width.size()) { this->output('\n'); c = 0; }
     }
     delete[] *i;
   }
-  max_width.clear();
   data.clear();
+  next = 0;
+  end = 0;
 }
 
 template<typename input_base_t, typename output_base_t> void basic_tabular_writer_t<input_base_t, output_base_t>::reinit_state(int more_passes)
 {
   line = 0;
   column = 0;
+  sampled = 0;
   max_width.clear();
   for(vector<char*>::iterator i = data.begin(); i != data.end(); ++i) delete[] *i;
   data.clear();
@@ -1558,25 +3093,19 @@ template<typename input_base_t, typename output_base_t> void basic_tabular_write
 
 template<typename input_base_t, typename output_base_t> void basic_tabular_writer_t<input_base_t, output_base_t>::process_token(const char* token, size_t len)
 {
-  if(line < 20) {
-    if(max_width[column] < len) max_width[column] = len;
-    if(!next || next + len + 2 > end) {
-      if(next) *next++ = '\03';
-      size_t cap = 32 * 1024;
-      if(cap < len + 2) cap = len + 2;
-      data.push_back(new char[cap]);
-      next = data.back();
-      end = data.back() + cap;
-    }
-    memcpy(next, token, len); next += len;
-    *next++ = '\0';
-  }
-  else {
-    if(max_width[column] < len) max_width[column] = len;
-    size_t spaces = 1 + max_width[column] - len;
-    for(size_t i = 0; i < spaces; ++i) this->output(' ');
-    this->output(token, len);
+  if(sampled) { output_cell(token, len); ++column; return; }
+
+  //room is always left for the end of block length
+  if(max_width[column] < len) max_width[column] = len;
+  if(!next || next + len + 2 * sizeof(size_t) > end) {
+    if(next) { const size_t end_len = size_t(-1); memcpy(next, &end_len, sizeof(size_t)); }
+    const size_t cap = max(size_t(32 * 1024), len + 2 * sizeof(size_t));
+    data.push_back(new char[cap]);
+    next = data.back();
+    end = data.back() + cap;
   }
+  memcpy(next, &len, sizeof(size_t)); next += sizeof(size_t);
+  memcpy(next, token, len); next += len;
 
   ++column;
 }
@@ -1586,23 +3115,289 @@ template<typename input_base_t, typename output_base_t> void basic_tabular_write
 // driver
 ////////////////////////////////////////////////////////////////////////////////////////////////
 
-template<typename reader_t, typename output_base_t> void csv_reader_base_t<reader_t, output_base_t>::process_keys(bool eof)
+template<typename reader_t> void* read_ahead_reader_t<reader_t>::read_ahead_main(void* data)
+{
+  //a buffer is filled by reads of at most read_size so abort is seen between them, a short read hands it over as is
+  const size_t read_size = 256 * 1024;
+  read_ahead_reader_t<reader_t>& r = *static_cast<read_ahead_reader_t<reader_t>*>(data);
+
+  bool at_end = 0;
+  while(1) {
+    pthread_mutex_lock(&r.mutex);
+    while(!r.abort && r.filled == r.buf_count) pthread_cond_wait(&r.prod_cond, &r.mutex);
+    const bool abort = r.abort;
+    pthread_mutex_unlock(&r.mutex);
+    if(abort) break;
+
+    char* buf = r.bufs[r.write_buf];
+    size_t len = 0;
+    bool error = 0;
+    string error_msg;
+    try {
+      while(!at_end && len < r.buf_size && !__atomic_load_n(&r.abort, __ATOMIC_SEQ_CST)) {
+        const size_t want = min(read_size, r.buf_size - len);
+        ssize_t num_read = r.reader_t::read(buf + len, want);
+        if(num_read <= 0) at_end = 1;
+        else len += num_read;
+        if(size_t(num_read) < want) break;
+      }
+    }
+    catch(exception& e) { error = 1; error_msg = e.what(); }
+    catch(...) { error = 1; error_msg = "couldn't read"; }
+    if(error) len = 0;
+
+    pthread_mutex_lock(&r.mutex);
+    r.lens[r.write_buf] = len;
+    r.write_buf = (r.write_buf + 1) % r.buf_count;
+    ++r.filled;
+    r.error = error;
+    r.error_msg = error_msg;
+    pthread_cond_signal(&r.cons_cond);
+    pthread_mutex_unlock(&r.mutex);
+    if(!len) break;
+  }
+
+  return 0;
+}
+
+template<typename reader_t> void read_ahead_reader_t<reader_t>::start()
+{
+  if(bufs.size() != buf_count) {
+    for(vector<char*>::iterator i = bufs.begin(); i != bufs.end(); ++i) delete[] *i;
+    bufs.clear();
+    for(size_t i = 0; i < buf_count; ++i) bufs.push_back(new char[buf_size]);
+  }
+  lens.resize(buf_count);
+  write_buf = 0;
+  read_buf = 0;
+  filled = 0;
+  read_off = 0;
+  have_read_buf = 0;
+  error = 0;
+  abort = 0;
+  pthread_mutex_init(&mutex, 0);
+  pthread_cond_init(&prod_cond, 0);
+  pthread_cond_init(&cons_cond, 0);
+  if(pthread_create(&thread, 0, read_ahead_reader_t<reader_t>::read_ahead_main, this)) {
+    pthread_cond_destroy(&cons_cond);
+    pthread_cond_destroy(&prod_cond);
+    pthread_mutex_destroy(&mutex);
+    throw runtime_error("can't create read ahead thread");
+  }
+  thread_created = 1;
+}
+
+template<typename reader_t> void read_ahead_reader_t<reader_t>::stop()
+{
+  //the thread stops at its next check of abort, at most one bounded read away
+  if(!thread_created) return;
+
+  pthread_mutex_lock(&mutex);
+  __atomic_store_n(&abort, 1, __ATOMIC_SEQ_CST);
+  pthread_cond_signal(&prod_cond);
+  pthread_mutex_unlock(&mutex);
+  pthread_join(thread, 0);
+  pthread_cond_destroy(&cons_cond);
+  pthread_cond_destroy(&prod_cond);
+  pthread_mutex_destroy(&mutex);
+  thread_created = 0;
+}
+
+template<typename reader_t> void read_ahead_reader_t<reader_t>::set_read_ahead(size_t buf_count, size_t buf_size)
+{
+  if(thread_created) throw runtime_error("can't change read ahead while reading");
+  if(buf_count < 2 || !buf_size) throw runtime_error("invalid read ahead buffers");
+  for(vector<char*>::iterator i = bufs.begin(); i != bufs.end(); ++i) delete[] *i;
+  bufs.clear();
+  this->buf_count = buf_count;
+  this->buf_size = buf_size;
+}
+
+template<typename reader_t> const char* read_ahead_reader_t<reader_t>::next_buffer(size_t& len)
+{
+  if(!thread_created) start();
+
+  if(have_read_buf) {
+    pthread_mutex_lock(&mutex);
+    read_buf = (read_buf + 1) % buf_count;
+    --filled;
+    pthread_cond_signal(&prod_cond);
+    pthread_mutex_unlock(&mutex);
+    have_read_buf = 0;
+  }
+
+  pthread_mutex_lock(&mutex);
+  while(!filled) pthread_cond_wait(&cons_cond, &mutex);
+  const bool error = this->error;
+  pthread_mutex_unlock(&mutex);
+  read_off = 0;
+  have_read_buf = 1;
+  len = lens[read_buf];
+  if(!len) {
+    stop();
+    if(error) throw runtime_error(error_msg);
+    return 0;
+  }
+  return bufs[read_buf];
+}
+
+template<typename reader_t> ssize_t read_ahead_reader_t<reader_t>::read(void* buf, size_t len)
 {
+  while(!thread_created || !have_read_buf || read_off == lens[read_buf]) {
+    size_t n;
+    if(!next_buffer(n)) return 0;
+  }
+  const size_t n = min(lens[read_buf] - read_off, len);
+  memcpy(buf, bufs[read_buf] + read_off, n);
+  read_off += n;
+  return n;
+}
+
+template<typename reader_t, typename output_base_t, typename delim_t> const char* csv_reader_base_t<reader_t, output_base_t, delim_t>::quoted_end(const char* start, const char* end, bool eof, bool& escaped, bool& bad)
+{
+  //start is on an opening quote, returns one past the closing one or 0 if it isn't before end yet
+  escaped = 0;
+  bad = 0;
+  const char* p = start + 1;
+  while(1) {
+    const char* q = static_cast<const char*>(memchr(p, delim_t::quote, end - p));
+    if(!q || (q + 1 == end && !eof)) return 0;
+    if(q + 1 != end && q[1] == delim_t::quote) { escaped = 1; p = q + 2; continue; }
+    bad = q + 1 != end && q[1] != delim_t::delim && q[1] != '\n';
+    return q + 1;
+  }
+}
+
+template<typename reader_t, typename output_base_t, typename delim_t> const char* csv_reader_base_t<reader_t, output_base_t, delim_t>::quoted_token(bool eof, const char*& token, size_t& len)
+{
+  //the field is only unescaped once its closing quote is in the buffer so a partial field can be carried over untouched
+  bool escaped, bad;
+  const char* end = quoted_end(start, data_end, eof, escaped, bad);
+  if(!end) {
+    if(!eof) return 0;
+    stringstream msg; msg << "Line " << line << " has an unterminated quoted field";
+    throw runtime_error(msg.str());
+  }
+  if(bad) {
+    stringstream msg; msg << "Line " << line << " has text after a closing quote";
+    throw runtime_error(msg.str());
+  }
+
+  if(!escaped) { token = start + 1; len = end - 1 - token; }
+  else {
+    //a block may still point at earlier fields in unescaped, so it is output before unescaped could move
+    if(!(output_base_t::block_output && block_rows)) unescaped.clear();
+    else if(unescaped.capacity() - unescaped.size() < size_t(end - start)) flush_block();
+    const size_t off = unescaped.size();
+    unescape(start, end, unescaped);
+    token = &unescaped[0] + off; len = unescaped.size() - off;
+  }
+  return end;
+}
+
+template<typename reader_t, typename output_base_t, typename delim_t> void csv_reader_base_t<reader_t, output_base_t, delim_t>::carry()
+{
+  //move the unfinished token to the front of buf, in mapped mode start is in the mapping and buf may need to grow
+  flush_block();
+  if(start == buf) return;
+  const size_t len = data_end - start;
+  if(!buf || size_t(buf_end - buf) < len + 128) {
+    char* new_buf = new char[len + 128];
+    memcpy(new_buf, start, len);
+    delete[] buf;
+    buf = new_buf;
+    buf_end = buf + len + 128;
+  }
+  else memmove(buf, start, len);
+  start = buf;
+  data_end = buf + len;
+}
+
+template<typename reader_t, typename output_base_t, typename delim_t> void csv_reader_base_t<reader_t, output_base_t, delim_t>::output_key(const char* token, size_t len)
+{
+  if(infer_rows) string_columns.push_back(string_keys.find(string(token, len)) != string_keys.end());
+  output_base_t::output_key(token, len);
+}
+
+template<typename reader_t, typename output_base_t, typename delim_t> void csv_reader_base_t<reader_t, output_base_t, delim_t>::output_keys()
+{
+  column_modes.clear();
+  const vector<bool>* skip_columns = this->output_skip_columns();
+  output_base_t::output_keys();
+  if(skip_columns) {
+    for(vector<bool>::const_iterator i = skip_columns->begin(); i != skip_columns->end(); ++i) column_modes.push_back(*i ? CM_SKIP : CM_TOKEN);
+  }
+  if(infer_rows) {
+    column_modes.resize(column, CM_TOKEN);
+    for(size_t i = 0; i < column; ++i) if(column_modes[i] == CM_TOKEN && !string_columns[i]) column_modes[i] = CM_SAMPLE;
+    sample_rows_left = infer_rows;
+  }
+}
+
+template<typename reader_t, typename output_base_t, typename delim_t> void csv_reader_base_t<reader_t, output_base_t, delim_t>::output_column(const char* token, size_t len)
+{
+  const char mode = column < column_modes.size() ? column_modes[column] : char(CM_TOKEN);
+  double value;
+  if(mode == CM_TOKEN) this->output_token(token, len);
+  else if(mode == CM_NUMBER) {
+    if(!len) output_null();
+    else if(parse_number(token, len, value)) this->output_token(value);
+    else this->output_token(token, len);
+  }
+  else if(mode == CM_SAMPLE) {
+    if(len && !parse_number(token, len, value)) column_modes[column] = CM_SAMPLE_TEXT;
+    this->output_token(token, len);
+  }
+  else if(mode == CM_SAMPLE_TEXT) this->output_token(token, len);
+}
+
+template<typename reader_t, typename output_base_t, typename delim_t> void csv_reader_base_t<reader_t, output_base_t, delim_t>::add_column(row_block_t& to, size_t column, const char* token, size_t len) const
+{
+  //output_column once sampling is over, for the workers of run_mapped
+  const char mode = column < column_modes.size() ? column_modes[column] : char(CM_TOKEN);
+  double value;
+  if(mode == CM_SKIP) return;
+  if(mode != CM_NUMBER) to.add_token(token, len);
+  else if(!len) to.add_null();
+  else if(parse_number(token, len, value)) to.add_token(value);
+  else to.add_token(token, len);
+}
+
+template<typename reader_t, typename output_base_t, typename delim_t> void csv_reader_base_t<reader_t, output_base_t, delim_t>::end_sample()
+{
+  //columns that only held numbers in the sample rows are output as doubles from here on
+  bool per_column = 0;
+  for(vector<char>::iterator i = column_modes.begin(); i != column_modes.end(); ++i) {
+    if(*i == CM_SAMPLE) *i = CM_NUMBER;
+    else if(*i == CM_SAMPLE_TEXT) *i = CM_TOKEN;
+    if(*i != CM_TOKEN) per_column = 1;
+  }
+  if(!per_column) column_modes.clear();
+}
+
+template<typename reader_t, typename output_base_t, typename delim_t> void csv_reader_base_t<reader_t, output_base_t, delim_t>::process_keys(bool eof)
+{
+  delim_scanner_t<delim_t::delim, delim_t::quote> scanner;
   while(1) { // tokens
-    const char* end = start;
-    while(end < data_end && *end != '\n' && *end != ',') ++end;
+    const char* token = start;
+    const char* end;
+    size_t len;
+    if(delim_t::quote && start != data_end && *start == delim_t::quote) {
+      if(!(end = quoted_token(eof, token, len))) { carry(); break; }
+    }
+    else { end = find_end(scanner, start); len = end - start; }
 
     if(end == data_end) {
       if(eof) {
-        if(column || start != end) { this->output_key(start, end - start); column++; }
+        if(column || start != end) { this->output_key(token, len); column++; }
         if(column) { this->output_keys(); num_keys = column; }
       }
-      else if(start != buf) { const size_t len = end - start; memcpy(buf, start, len); start = buf; data_end = buf + len; }
+      else carry();
       break;
     }
-    else if(*end == ',') { this->output_key(start, end - start); ++column; start = end + 1; }
+    else if(*end == delim_t::delim) { this->output_key(token, len); ++column; start = end + 1; }
     else {
-      if(column || start != end) { this->output_key(start, end - start); ++column; }
+      if(column || start != end) { this->output_key(token, len); ++column; }
       if(column) { this->output_keys(); num_keys = column; in_keys = 0; }
       column = 0; ++line; start = end + 1;
       break;
@@ -1610,35 +3405,43 @@ template<typename reader_t, typename output_base_t> void csv_reader_base_t<reade
   }
 }
 
-template<typename reader_t, typename output_base_t> void csv_reader_base_t<reader_t, output_base_t>::process(bool eof)
+template<typename reader_t, typename output_base_t, typename delim_t> template<bool per_column> void csv_reader_base_t<reader_t, output_base_t, delim_t>::process_tokens(bool eof)
 {
+  delim_scanner_t<delim_t::delim, delim_t::quote> scanner;
   while(1) { // tokens
-    const char* end = start;
-    while(end < data_end && *end != '\n' && *end != ',') ++end;
+    const char* token = start;
+    const char* end;
+    size_t len;
+    if(delim_t::quote && start != data_end && *start == delim_t::quote) {
+      if(!(end = quoted_token(eof, token, len))) { carry(); break; }
+    }
+    else { end = find_end(scanner, start); len = end - start; }
 
     if(end == data_end) {
       if(eof) {
-        if(column || start != end) { this->output_token(start, end - start); column++; }
+        if(column || start != end) { if(per_column) output_column(token, len); else this->output_token(token, len); column++; }
         if(column) {
           if(column != num_keys) {
             stringstream msg; msg << "Line " << line << " had " << column << " tokens when num_keys is " << num_keys;
             throw runtime_error(msg.str());
           }
           this->output_line();
+          if(per_column && sample_rows_left && !--sample_rows_left) end_sample();
         }
       }
-      else if(start != buf) { const size_t len = end - start; memcpy(buf, start, len); start = buf; data_end = buf + len; }
+      else carry();
       break;
     }
-    else if(*end == ',') { this->output_token(start, end - start); ++column; start = end + 1; }
+    else if(*end == delim_t::delim) { if(per_column) output_column(token, len); else this->output_token(token, len); ++column; start = end + 1; }
     else {
-      if(column || start != end) { this->output_token(start, end - start); column++; }
+      if(column || start != end) { if(per_column) output_column(token, len); else this->output_token(token, len); column++; }
       if(column) {
         if(column != num_keys) {
           stringstream msg; msg << "Line " << line << " had " << column << " tokens when num_keys is " << num_keys;
           throw runtime_error(msg.str());
         }
         this->output_line();
+        if(per_column && sample_rows_left && !--sample_rows_left) end_sample();
         column = 0;
       }
       ++line; start = end + 1;
@@ -1646,30 +3449,830 @@ template<typename reader_t, typename output_base_t> void csv_reader_base_t<reade
   }
 }
 
-template<typename reader_t, typename output_base_t> int csv_reader_base_t<reader_t, output_base_t>::run()
+template<typename reader_t, typename output_base_t, typename delim_t> void csv_reader_base_t<reader_t, output_base_t, delim_t>::process(bool eof)
+{
+  //the scanner stops on quotes as well, so a quoted field is only handled where one starts a token
+  if(column_modes.empty()) process_tokens<0>(eof);
+  else process_tokens<1>(eof);
+}
+
+template<typename reader_t, typename output_base_t, typename delim_t> void csv_reader_base_t<reader_t, output_base_t, delim_t>::parse_chunk(const void* context, csv_parallel_scanner_t::chunk_t& ch)
+{
+  //process_tokens on a worker, taking the chunk to start outside of any quoted field, run_mapped only uses chunks where that held
+  const csv_reader_base_t<reader_t, output_base_t, delim_t>& r = *static_cast<const csv_reader_base_t<reader_t, output_base_t, delim_t>*>(context);
+  delim_scanner_t<delim_t::delim, delim_t::quote> scanner;
+  ch.block.clear();
+  ch.unescaped.clear();
+  ch.error.clear();
+  ch.tail = ch.begin;
+  ch.lines = 0;
+  size_t column = 0;
+  for(const char* p = ch.begin; p != ch.end;) {
+    const char* token = p;
+    const char* end;
+    size_t len;
+    if(delim_t::quote && *p == delim_t::quote) {
+      bool escaped, bad;
+      if(!(end = quoted_end(p, ch.end, 0, escaped, bad))) break;
+      if(bad) { ch.error = " has text after a closing quote"; break; }
+      if(!escaped) { token = p + 1; len = end - 1 - token; }
+      else {
+        if(ch.unescaped.empty()) ch.unescaped.reserve(ch.end - ch.begin);
+        const size_t off = ch.unescaped.size();
+        unescape(p, end, ch.unescaped);
+        token = &ch.unescaped[0] + off; len = ch.unescaped.size() - off;
+      }
+    }
+    else {
+      end = scanner.find(p, ch.end);
+      while(delim_t::quote && end != ch.end && *end == delim_t::quote) end = scanner.find(end + 1, ch.end);
+      len = end - p;
+    }
+
+    if(end == ch.end) break;
+    else if(*end == delim_t::delim) { r.add_column(ch.block, column, token, len); ++column; }
+    else {
+      if(column || p != end) { r.add_column(ch.block, column, token, len); ++column; }
+      if(column) {
+        if(column != r.num_keys) { stringstream msg; msg << " had " << column << " tokens when num_keys is " << r.num_keys; ch.error = msg.str(); break; }
+        ch.block.add_line();
+        column = 0;
+      }
+      ++ch.lines;
+      ch.tail = end + 1;
+    }
+    p = end + 1;
+  }
+
+  //drop the tokens of a line that didn't finish
+  const size_t tokens = ch.block.line_ends.empty() ? 0 : ch.block.line_ends.back();
+  ch.block.tokens.resize(tokens);
+  ch.block.lens.resize(tokens);
+}
+
+template<typename reader_t, typename output_base_t, typename delim_t> void csv_reader_base_t<reader_t, output_base_t, delim_t>::process_range(const char* b, const char* b_end)
+{
+  //tokens point straight into [b, b_end), only a line cut by the end of a range is put back together in buf
+  while(b != b_end) {
+    if(data_end != buf) {
+      const char* nl = static_cast<const char*>(memchr(b, '\n', b_end - b));
+      const size_t n = (nl ? nl + 1 : b_end) - b;
+      char* fill = buf + (data_end - buf);
+      if(fill + n + 128 > buf_end) { resize_buffer(buf, fill, buf_end, n + 128); start = buf; }
+      memcpy(fill, b, n);
+      data_end = fill + n;
+      b += n;
+    }
+    else { start = b; data_end = b_end; b = b_end; }
+    do { if(in_keys) process_keys(0); } while(in_keys && start != buf);
+    if(!in_keys) process(0);
+  }
+}
+
+template<typename reader_t, typename output_base_t, typename delim_t> template<typename from_t> void csv_reader_base_t<reader_t, output_base_t, delim_t>::read_from(from_t& from)
+{
+  const size_t read_size = 32 * 1024;
+
+  size_t num_read; do {
+    char* fill = buf + (data_end - buf);
+    if(fill + read_size + 1 > buf_end) { const size_t off = start - buf; resize_buffer(buf, fill, buf_end, read_size); start = buf + off; }
+    num_read = from.read(fill, read_size);
+    data_end = fill + num_read;
+    if(in_keys) process_keys(num_read == 0);
+    if(!in_keys) process(num_read == 0);
+  } while(num_read > 0);
+}
+
+template<typename reader_t, typename output_base_t, typename delim_t> template<typename from_t> void csv_reader_base_t<reader_t, output_base_t, delim_t>::read_from(read_ahead_reader_t<from_t>& from)
+{
+  //the ring buffers are parsed in place, the block pointing into one is output before it goes back
+  const char* b;
+  size_t len;
+  while((b = from.next_buffer(len))) {
+    process_range(b, b + len);
+    flush_block();
+  }
+
+  if(in_keys) process_keys(1);
+  if(!in_keys) process(1);
+}
+
+template<typename reader_t, typename output_base_t, typename delim_t> int csv_reader_base_t<reader_t, output_base_t, delim_t>::run()
+{
+  const size_t read_size = 32 * 1024;
+
+  line = 0;
+  column = 0;
+  if(!buf) { buf = new char[read_size + 128]; buf_end = buf + read_size + 128; }
+  start = buf;
+  data_end = buf;
+  in_keys = 1;
+  block.clear();
+  column_modes.clear();
+  sample_rows_left = 0;
+  string_columns.clear();
+  read_from(r);
+
+  flush_block();
+
+#ifdef TABLE_DIMENSIONS_DEBUG_PRINTS
+  cerr << "read_csv saw dimensions of " << num_keys << " by " << line << endl;
+#endif
+  this->output_stream();
+
+  return 0;
+}
+
+template<typename reader_t, typename output_base_t, typename delim_t> int csv_reader_base_t<reader_t, output_base_t, delim_t>::run_mapped(const char* begin, const char* end, size_t threads, size_t chunk_size)
+{
+  line = 0;
+  column = 0;
+  in_keys = 1;
+  block.clear();
+  column_modes.clear();
+  sample_rows_left = 0;
+  string_columns.clear();
+  start = buf;
+  data_end = buf;
+
+  //the keys and the rows numeric columns are sampled from set up column_modes, so they are parsed here before any worker starts
+  const char* p = begin;
+  while(p != end && (in_keys || sample_rows_left)) {
+    const char* e = p;
+    for(size_t n = in_keys ? 1 : sample_rows_left; n && e != end; --n) {
+      const char* nl = static_cast<const char*>(memchr(e, '\n', end - e));
+      e = nl ? nl + 1 : end;
+    }
+    process_range(p, e);
+    p = e;
+  }
+
+  const char* tail = end;
+  while(tail > p && *(tail - 1) != '\n') --tail;
+  if(threads > 1 && tail != p) {
+    //a chunk's row block is only good if the chunk before it ended outside a quoted field, otherwise it is parsed again here
+    flush_block();
+    csv_parallel_scanner_t ps; ps.start(p, tail, threads, chunk_size, parse_chunk, this);
+    for(const csv_parallel_scanner_t::chunk_t* ch; (ch = ps.next());) {
+      if(data_end != buf) { process_range(ch->begin, ch->end); continue; }
+      if(!ch->block.empty()) this->output_block(ch->block);
+      line += ch->lines;
+      if(!ch->error.empty()) { stringstream msg; msg << "Line " << line << ch->error; throw runtime_error(msg.str()); }
+      process_range(ch->tail, ch->end);
+    }
+    p = tail;
+  }
+  process_range(p, end);
+
+  if(in_keys) process_keys(1);
+  if(!in_keys) process(1);
+
+  flush_block();
+
+#ifdef TABLE_DIMENSIONS_DEBUG_PRINTS
+  cerr << "read_csv saw dimensions of " << num_keys << " by " << line << endl;
+#endif
+  this->output_stream();
+
+  return 0;
+}
+
+template<typename reader_t, typename output_base_t> void fixed_width_reader_base_t<reader_t, output_base_t>::process_record(const char* record)
+{
+  if(newline && record[record_len] != '\n') {
+    stringstream msg; msg << "Record " << line << " isn't " << record_len << " bytes long";
+    throw runtime_error(msg.str());
+  }
+  for(size_t column = 0; column < widths.size(); ++column) {
+    size_t len = widths[column];
+    if(skip.empty() || !skip[column]) {
+      if(trim) while(len && record[len - 1] == ' ') --len;
+      memcpy(&field[0], record, len); field[len] = '\0';
+      this->output_token(&field[0], len);
+    }
+    record += widths[column];
+  }
+  this->output_line();
+  ++line;
+}
+
+template<typename reader_t, typename output_base_t> int fixed_width_reader_base_t<reader_t, output_base_t>::run()
+{
+  if(widths.empty()) throw runtime_error("fixed width reader has no columns");
+  const size_t stride = record_len + newline;
+  const size_t cap = max(size_t(32 * 1024), stride) + stride;
+  if(!buf || size_t(buf_end - buf) < cap) { delete[] buf; buf = new char[cap]; buf_end = buf + cap; }
+  field.resize(*max_element(widths.begin(), widths.end()) + 1);
+
+  line = 0;
+  for(vector<string>::const_iterator i = keys.begin(); i != keys.end(); ++i) this->output_key((*i).c_str(), (*i).size());
+  skip.clear();
+  const vector<bool>* skip_columns = this->output_skip_columns();
+  this->output_keys();
+  if(skip_columns) skip.assign(skip_columns->begin(), skip_columns->end());
+  skip.resize(skip.empty() ? 0 : widths.size(), 0);
+
+  //only the record boundaries are looked at, a partial record is moved to the front before the next read
+  char* data_end = buf;
+  size_t num_read; do {
+    num_read = r.read(data_end, buf_end - data_end);
+    data_end += num_read;
+    const char* start = buf;
+    for(; size_t(data_end - start) >= stride; start += stride) process_record(start);
+    const size_t len = data_end - start;
+    memmove(buf, start, len);
+    data_end = buf + len;
+  } while(num_read > 0);
+
+  if(data_end != buf) {
+    if(newline && size_t(data_end - buf) == record_len) { *data_end = '\n'; process_record(buf); }
+    else {
+      stringstream msg; msg << "Record " << line << " isn't " << record_len << " bytes long";
+      throw runtime_error(msg.str());
+    }
+  }
+
+  this->output_stream();
+
+  return 0;
+}
+
+
+template<typename reader_t> bool record_reader_t<reader_t>::fill(size_t len)
+{
+  if(size_t(data_end - next) >= len) return 1;
+
+  //move what's left to the front, growing the buffer if a single record doesn't fit
+  const size_t left = data_end - next;
+  if(size_t(buf_end - buf) < len) {
+    const size_t cap = max(len, size_t(buf_end - buf) * 2);
+    char* new_buf = new char[cap];
+    memcpy(new_buf, next, left);
+    delete[] buf; buf = new_buf; buf_end = buf + cap;
+  }
+  else memmove(buf, next, left);
+  next = buf;
+  data_end = buf + left;
+
+  while(size_t(data_end - next) < len) {
+    const size_t num_read = reader_t::read(data_end, buf_end - data_end);
+    if(!num_read) return 0;
+    data_end += num_read;
+  }
+  return 1;
+}
+
+template<typename reader_t> bool record_reader_t<reader_t>::skip(size_t len)
+{
+  while(size_t(data_end - next) < len) {
+    len -= data_end - next;
+    next = data_end = buf;
+    const size_t num_read = reader_t::read(buf, buf_end - buf);
+    if(!num_read) return 0;
+    data_end += num_read;
+  }
+  next += len;
+  return 1;
+}
+
+template<typename reader_t> bool record_reader_t<reader_t>::read_len(size_t& len)
+{
+  len = 0;
+  for(int shift = 0; shift < 64; shift += 7) {
+    if(!fill(1)) return 0;
+    const unsigned char c = *next++;
+    len |= size_t(c & 0x7f) << shift;
+    if(!(c & 0x80)) return 1;
+  }
+  throw runtime_error("invalid varint length");
+}
+
+template<typename reader_t, typename output_base_t> int binary_reader_base_t<reader_t, output_base_t>::run()
+{
+  r.reset();
+
+  if(!r.fill(8) || memcmp(r.next, binary_magic, 4)) throw runtime_error("not a binary table stream");
+  if((unsigned char)r.next[4] > binary_version) {
+    stringstream msg; msg << "unsupported binary table version " << int((unsigned char)r.next[4]);
+    throw runtime_error(msg.str());
+  }
+  if(r.next[5] != 1 && r.next[5] != 2) throw runtime_error("invalid byte order in binary table stream");
+  const bool swap = r.next[5] != binary_byte_order();
+  r.next += 8;
+
+  while(1) {
+    if(!r.fill(1)) throw runtime_error("truncated binary stream");
+    const char tag = *r.next++;
+    if(tag == BT_TOKEN || tag == BT_KEY) {
+      size_t len;
+      if(!r.read_len(len) || !r.fill(len)) throw runtime_error("truncated binary stream");
+      if(tag == BT_TOKEN) this->output_token(r.next, len);
+      else this->output_key(r.next, len);
+      r.next += len;
+    }
+    else if(tag == BT_DOUBLE) {
+      if(!r.fill(sizeof(double))) throw runtime_error("truncated binary stream");
+      this->output_token(binary_double(r.next, swap));
+      r.next += sizeof(double);
+    }
+    else if(tag == BT_LINE) this->output_line();
+    else if(tag == BT_KEYS) this->output_keys();
+    else if(tag == BT_STREAM) break;
+    else {
+      stringstream msg; msg << "invalid tag " << int((unsigned char)tag) << " in binary table stream";
+      throw runtime_error(msg.str());
+    }
+  }
+
+  this->output_stream();
+
+  return 0;
+}
+
+
+template<typename reader_t, typename output_base_t> int columnar_reader_base_t<reader_t, output_base_t>::run()
+{
+  r.reset();
+  blocks_read = 0;
+  blocks_skipped = 0;
+
+  if(!r.fill(8) || memcmp(r.next, columnar_magic, 4)) throw runtime_error("not a columnar table stream");
+  if((unsigned char)r.next[4] > columnar_version) {
+    stringstream msg; msg << "unsupported columnar table version " << int((unsigned char)r.next[4]);
+    throw runtime_error(msg.str());
+  }
+  if(r.next[5] != 1 && r.next[5] != 2) throw runtime_error("invalid byte order in columnar table stream");
+  const bool swap = r.next[5] != binary_byte_order();
+  r.next += 8;
+
+  size_t num_keys; read_len(num_keys);
+  map<string, size_t> key_columns;
+  for(size_t c = 0; c < num_keys; ++c) {
+    size_t len; read_len(len);
+    if(!r.fill(len)) throw runtime_error("truncated columnar stream");
+    this->output_key(r.next, len);
+    key_columns[string(r.next, len)] = c;
+    r.next += len;
+  }
+  vector<char> skip(num_keys, 0);
+  const vector<bool>* skip_columns = this->output_skip_columns();
+  this->output_keys();
+  if(skip_columns) for(size_t c = 0; c < num_keys && c < skip_columns->size(); ++c) skip[c] = (*skip_columns)[c];
+  vector<char> needed(num_keys, 0);
+  for(size_t c = 0; c < num_keys; ++c) needed[c] = !skip[c];
+  for(typename vector<range_t>::iterator i = ranges.begin(); i != ranges.end(); ++i) {
+    map<string, size_t>::const_iterator k = key_columns.find((*i).key);
+    if(k == key_columns.end()) throw runtime_error("columnar_reader: no column named " + (*i).key);
+    (*i).column = (*k).second;
+    needed[(*i).column] = 1;
+  }
+
+  vector<block_column_t> block(num_keys);
+  vector<vector<char> > raw(num_keys);
+  vector<const char*> cursors(num_keys);
+  vector<cell_t> cells(num_keys);
+  while(1) {
+    size_t rows; read_len(rows);
+    if(!rows) break;
+
+    for(size_t c = 0; c < num_keys; ++c) {
+      block_column_t& b = block[c];
+      read_len(b.numbers); read_len(b.nulls); read_len(b.distinct);
+      if(!r.fill(2 * sizeof(double) + 1)) throw runtime_error("truncated columnar stream");
+      b.min = binary_double(r.next, swap); b.max = binary_double(r.next + sizeof(double), swap); b.codec = r.next[2 * sizeof(double)];
+      r.next += 2 * sizeof(double) + 1;
+      read_len(b.raw_len); read_len(b.stored_len);
+    }
+
+    //the zone maps rule out a block when a range's column has no numbers in it or its min and max miss the range
+    bool skip_block = 0;
+    for(typename vector<range_t>::const_iterator i = ranges.begin(); i != ranges.end() && !skip_block; ++i) {
+      const block_column_t& b = block[(*i).column];
+      skip_block = !b.numbers || (*i).min > b.max || b.min > (*i).max;
+    }
+    if(skip_block) ++blocks_skipped;
+    else ++blocks_read;
+
+    for(size_t c = 0; c < num_keys; ++c) {
+      const block_column_t& b = block[c];
+      if(skip_block || !needed[c]) { if(!r.skip(b.stored_len)) throw runtime_error("truncated columnar stream"); continue; }
+      if(!r.fill(b.stored_len)) throw runtime_error("truncated columnar stream");
+      raw[c].resize(b.raw_len + 1);
+      decompress_block(b.codec, r.next, b.stored_len, &raw[c][0], b.raw_len);
+      r.next += b.stored_len;
+      cursors[c] = &raw[c][0];
+    }
+    if(skip_block) continue;
+
+    for(size_t row = 0; row < rows; ++row) {
+      for(size_t c = 0; c < num_keys; ++c) {
+        if(!needed[c]) continue;
+        cell_t& cell = cells[c];
+        const char*& p = cursors[c];
+        const char* end = &raw[c][0] + block[c].raw_len;
+        if(p == end) throw runtime_error("invalid columnar block");
+        cell.tag = *p++;
+        if(cell.tag == BT_DOUBLE) { if(size_t(end - p) < sizeof(double)) throw runtime_error("invalid columnar block"); cell.value = binary_double(p, swap); p += sizeof(double); }
+        else if(cell.tag == BT_TOKEN) {
+          cell.len = 0;
+          for(int shift = 0; p != end; shift += 7) { const unsigned char b = *p++; cell.len |= size_t(b & 0x7f) << shift; if(!(b & 0x80)) break; }
+          if(size_t(end - p) < cell.len) throw runtime_error("invalid columnar block");
+          cell.token = p; p += cell.len;
+        }
+        else if(cell.tag != BT_NULL) throw runtime_error("invalid columnar block");
+      }
+
+      bool keep = 1;
+      for(typename vector<range_t>::const_iterator i = ranges.begin(); i != ranges.end() && keep; ++i) {
+        const cell_t& cell = cells[(*i).column];
+        double value = cell.value;
+        keep = (cell.tag == BT_DOUBLE || (cell.tag == BT_TOKEN && parse_number(cell.token, cell.len, value))) && value >= (*i).min && value <= (*i).max;
+      }
+      if(!keep) continue;
+
+      for(size_t c = 0; c < num_keys; ++c) {
+        if(skip[c]) continue;
+        const cell_t& cell = cells[c];
+        if(cell.tag == BT_DOUBLE) this->output_token(cell.value);
+        else if(cell.tag == BT_TOKEN) this->output_token(cell.token, cell.len);
+        else this->output_token("", 0);
+      }
+      this->output_line();
+    }
+  }
+
+  this->output_stream();
+
+  return 0;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+// columnar_writer
+////////////////////////////////////////////////////////////////////////////////////////////////
+
+template<typename input_base_t, typename output_base_t> typename basic_columnar_writer_t<input_base_t, output_base_t>::column_t& basic_columnar_writer_t<input_base_t, output_base_t>::next_column()
+{
+  if(column == columns.size()) {
+    stringstream msg; msg << "columnar_writer: line " << line << " (zero's based) has more than " << columns.size() << " columns";
+    throw runtime_error(msg.str());
+  }
+  return columns[column++];
+}
+
+template<typename input_base_t, typename output_base_t> void basic_columnar_writer_t<input_base_t, output_base_t>::add_cell(column_t& c, const char* cell, size_t len)
+{
+  c.cells.insert(c.cells.end(), cell, cell + len);
+  uint32_t hash = 2166136261U;
+  for(const char* p = cell; p != cell + len; ++p) hash = (hash ^ (unsigned char)*p) * 16777619U;
+  hash %= distinct_bits;
+  c.distinct[hash / 64] |= uint64_t(1) << (hash % 64);
+}
+
+template<typename input_base_t, typename output_base_t> size_t basic_columnar_writer_t<input_base_t, output_base_t>::distinct_estimate(const column_t& c)
+{
+  //linear counting, close while the bitmap is less than about 90% full and capped at about 34000 when it is full
+  size_t unset = distinct_bits;
+  for(size_t i = 0; i < distinct_bits / 64; ++i) unset -= __builtin_popcountll(c.distinct[i]);
+  return size_t(distinct_bits * log(double(distinct_bits) / max(unset, size_t(1))) + 0.5);
+}
+
+template<typename input_base_t, typename output_base_t> void basic_columnar_writer_t<input_base_t, output_base_t>::output_block()
+{
+  output_varint(rows);
+  vector<vector<char> > stored(columns.size());
+  vector<char> codecs(columns.size());
+  for(size_t c = 0; c < columns.size(); ++c) {
+    const column_t& col = columns[c];
+    codecs[c] = compress_block(col.cells, stored[c]);
+    output_varint(col.numbers); output_varint(col.nulls); output_varint(distinct_estimate(col));
+    output_base_t::output(reinterpret_cast<const char*>(&col.min), sizeof(double));
+    output_base_t::output(reinterpret_cast<const char*>(&col.max), sizeof(double));
+    output_base_t::output(codecs[c]);
+    output_varint(col.cells.size());
+    output_varint(codecs[c] == BC_NONE ? col.cells.size() : stored[c].size());
+  }
+  for(size_t c = 0; c < columns.size(); ++c) {
+    const vector<char>& data = codecs[c] == BC_NONE ? columns[c].cells : stored[c];
+    if(!data.empty()) output_base_t::output(&data[0], data.size());
+  }
+
+  for(typename vector<column_t>::iterator i = columns.begin(); i != columns.end(); ++i) clear_column(*i);
+  rows = 0;
+}
+
+template<typename input_base_t, typename output_base_t> void basic_columnar_writer_t<input_base_t, output_base_t>::process_keys()
+{
+  const char header[8] = { columnar_magic[0], columnar_magic[1], columnar_magic[2], columnar_magic[3], char(columnar_version), char(binary_byte_order()), 0, 0 };
+  output_base_t::output(header, sizeof(header));
+  output_varint(keys.size());
+  for(vector<string>::const_iterator i = keys.begin(); i != keys.end(); ++i) { output_varint((*i).size()); output_base_t::output((*i).c_str(), (*i).size()); }
+  columns.resize(keys.size());
+  for(typename vector<column_t>::iterator i = columns.begin(); i != columns.end(); ++i) clear_column(*i);
+  rows = 0; column = 0; line = 0;
+}
+
+template<typename input_base_t, typename output_base_t> void basic_columnar_writer_t<input_base_t, output_base_t>::process_token(const char* token, size_t len)
+{
+  column_t& c = next_column();
+  if(!len) { const char tag = BT_NULL; add_cell(c, &tag, 1); ++c.nulls; return; }
+
+  char buf[10]; char* next = buf;
+  *next++ = char(BT_TOKEN);
+  for(size_t l = len; 1; l >>= 7) { if(l < 0x80) { *next++ = char(l); break; } *next++ = char((l & 0x7f) | 0x80); }
+  c.cells.insert(c.cells.end(), buf, next);
+  add_cell(c, token, len);
+
+  //text that reads as a number counts in the zone map, so a range can still find it
+  double value;
+  if(!parse_number(token, len, value)) return;
+  if(!c.numbers || value < c.min) c.min = value;
+  if(!c.numbers || value > c.max) c.max = value;
+  ++c.numbers;
+}
+
+template<typename input_base_t, typename output_base_t> void basic_columnar_writer_t<input_base_t, output_base_t>::process_token(double token)
+{
+  column_t& c = next_column();
+  char buf[1 + sizeof(double)]; buf[0] = char(BT_DOUBLE); memcpy(buf + 1, &token, sizeof(double));
+  add_cell(c, buf, sizeof(buf));
+  if(token != token) return; //NaN isn't in the min and max
+  if(!c.numbers || token < c.min) c.min = token;
+  if(!c.numbers || token > c.max) c.max = token;
+  ++c.numbers;
+}
+
+template<typename input_base_t, typename output_base_t> void basic_columnar_writer_t<input_base_t, output_base_t>::process_line()
+{
+  if(column != columns.size()) {
+    stringstream msg; msg << "columnar_writer: line " << line << " (zero's based) has " << column << " columns instead of " << columns.size();
+    throw runtime_error(msg.str());
+  }
+  column = 0; ++line;
+  if(++rows == block_rows) output_block();
+}
+
+template<typename input_base_t, typename output_base_t> void basic_columnar_writer_t<input_base_t, output_base_t>::process_stream()
+{
+  if(column) throw runtime_error("columnar_writer saw process_stream called after process_token");
+  if(rows) output_block();
+  output_varint(0);
+  this->flush();
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+// partitioned_writer
+////////////////////////////////////////////////////////////////////////////////////////////////
+
+template<typename input_base_t, typename writer_t> void* basic_partitioned_writer_t<input_base_t, writer_t>::stream_end_main(void* data)
+{
+  stream_end_t& se = *static_cast<stream_end_t*>(data);
+  try { se.w->process_stream(); }
+  catch(exception& e) { se.error = 1; se.error_msg = e.what(); }
+  catch(...) { se.error = 1; se.error_msg = "partition failed to end its stream"; }
+  return 0;
+}
+
+template<typename input_base_t, typename writer_t> void basic_partitioned_writer_t<input_base_t, writer_t>::open(const char* prefix, size_t count, const char* suffix)
+{
+  if(!count) throw runtime_error("partitioned_writer needs at least one partition");
+  for(typename vector<writer_t*>::iterator i = partitions.begin(); i != partitions.end(); ++i) delete *i;
+  partitions.clear();
+  for(size_t i = 0; i < count; ++i) {
+    stringstream path; path << prefix << i << suffix;
+    partitions.push_back(new writer_t);
+    partitions.back()->open(path.str().c_str());
+  }
+}
+
+template<typename input_base_t, typename writer_t> void basic_partitioned_writer_t<input_base_t, writer_t>::process_keys()
+{
+  if(partitions.empty()) throw runtime_error("partitioned_writer isn't open");
+  part_columns.assign(keys.size(), 0);
+  last_part_column = 0;
+  for(vector<string>::const_iterator i = part_keys.begin(); i != part_keys.end(); ++i) {
+    vector<string>::const_iterator k = find(keys.begin(), keys.end(), *i);
+    if(k == keys.end()) throw runtime_error("partitioned_writer: no column named " + *i);
+    part_columns[k - keys.begin()] = 1;
+    last_part_column = max(last_part_column, size_t(k - keys.begin()) + 1);
+  }
+  for(typename vector<writer_t*>::iterator i = partitions.begin(); i != partitions.end(); ++i) (*i)->process_keys();
+  line = 0;
+  start_line();
+}
+
+template<typename input_base_t, typename writer_t> void basic_partitioned_writer_t<input_base_t, writer_t>::start_line()
+{
+  row.clear(); column = 0;
+  hash = 2166136261U;
+  w = part_keys.empty() ? partitions[line % partitions.size()] : 0;
+}
+
+template<typename input_base_t, typename writer_t> void basic_partitioned_writer_t<input_base_t, writer_t>::hash_token(const char* token, size_t len)
+{
+  //the length goes in first, so no choice of bytes in one key can shift into the next
+  for(int b = 0; b < 64; b += 8) hash = (hash ^ (unsigned char)(uint64_t(len) >> b)) * 16777619U;
+  for(const char* p = token; p != token + len; ++p) hash = (hash ^ (unsigned char)*p) * 16777619U;
+}
+
+template<typename input_base_t, typename writer_t> void basic_partitioned_writer_t<input_base_t, writer_t>::pick_partition()
+{
+  //the same key values in the same columns always land in the same partition, in every run
+  w = partitions[hash % partitions.size()];
+  for(const char* p = row.empty() ? 0 : &row[0], *end = p + row.size(); p < end;) {
+    if(*p++ == 'd') { double token; memcpy(&token, p, sizeof(double)); p += sizeof(double); w->process_token(token); }
+    else { size_t len; memcpy(&len, p, sizeof(size_t)); p += sizeof(size_t); w->process_token(p, len); p += len; }
+  }
+  row.clear();
+}
+
+template<typename input_base_t, typename writer_t> void basic_partitioned_writer_t<input_base_t, writer_t>::process_token(const char* token, size_t len)
+{
+  if(w) { w->process_token(token, len); ++column; return; }
+  if(part_columns[column]) hash_token(token, len);
+  row.push_back('s');
+  row.insert(row.end(), reinterpret_cast<const char*>(&len), reinterpret_cast<const char*>(&len) + sizeof(size_t));
+  row.insert(row.end(), token, token + len);
+  if(++column == last_part_column) pick_partition();
+}
+
+template<typename input_base_t, typename writer_t> void basic_partitioned_writer_t<input_base_t, writer_t>::process_token(double token)
+{
+  if(w) { w->process_token(token); ++column; return; }
+  if(part_columns[column]) { char buf[32]; size_t len = dtostr(token, buf); hash_token(buf, len); }
+  row.push_back('d');
+  row.insert(row.end(), reinterpret_cast<const char*>(&token), reinterpret_cast<const char*>(&token) + sizeof(double));
+  if(++column == last_part_column) pick_partition();
+}
+
+template<typename input_base_t, typename writer_t> void basic_partitioned_writer_t<input_base_t, writer_t>::process_line()
+{
+  if(!w) pick_partition(); //a line too short to reach the last key column
+  w->process_line();
+  ++line;
+  start_line();
+}
+
+template<typename input_base_t, typename writer_t> void basic_partitioned_writer_t<input_base_t, writer_t>::process_stream()
+{
+  //each partition flushes on its own thread
+  vector<stream_end_t> ends(partitions.size());
+  for(size_t i = 0; i < partitions.size(); ++i) {
+    ends[i].w = partitions[i]; ends[i].error = 0;
+    ends[i].joinable = !pthread_create(&ends[i].thread, 0, basic_partitioned_writer_t<input_base_t, writer_t>::stream_end_main, &ends[i]);
+    if(!ends[i].joinable) stream_end_main(&ends[i]);
+  }
+  for(typename vector<stream_end_t>::iterator i = ends.begin(); i != ends.end(); ++i) if((*i).joinable) pthread_join((*i).thread, 0);
+  for(typename vector<stream_end_t>::const_iterator i = ends.begin(); i != ends.end(); ++i) if((*i).error) throw runtime_error((*i).error_msg);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+// arrow_writer
+////////////////////////////////////////////////////////////////////////////////////////////////
+
+template<typename input_base_t, typename output_base_t> typename basic_arrow_writer_t<input_base_t, output_base_t>::column_t& basic_arrow_writer_t<input_base_t, output_base_t>::next_column()
+{
+  if(column == columns.size()) {
+    stringstream msg; msg << "arrow_writer: a line has more than " << columns.size() << " columns";
+    throw runtime_error(msg.str());
+  }
+  return columns[column++];
+}
+
+template<typename input_base_t, typename output_base_t> void basic_arrow_writer_t<input_base_t, output_base_t>::add_double(column_t& c, double value, bool valid)
+{
+  const size_t row = c.values.size();
+  if(!(row & 7)) c.validity.push_back(0);
+  if(valid) c.validity.back() |= 1 << (row & 7);
+  else ++c.null_count;
+  c.values.push_back(value);
+}
+
+template<typename input_base_t, typename output_base_t> void basic_arrow_writer_t<input_base_t, output_base_t>::add_text(column_t& c, const char* token, size_t len, bool valid)
+{
+  vector<unsigned char>& validity = schema_written ? c.validity : c.text_validity;
+  const size_t row = c.offsets.size() - 1;
+  if(!(row & 7)) validity.push_back(0);
+  if(valid) validity.back() |= 1 << (row & 7);
+  else ++(schema_written ? c.null_count : c.text_null_count);
+  c.data.insert(c.data.end(), token, token + len);
+  c.offsets.push_back(int32_t(c.data.size()));
+}
+
+template<typename input_base_t, typename output_base_t> void basic_arrow_writer_t<input_base_t, output_base_t>::add_cell(column_t& c, const char* token, size_t len)
+{
+  if(!schema_written) {
+    if(len && c.is_double) { c.is_double = 0; c.validity.clear(); c.null_count = 0; c.values.clear(); }
+    if(c.is_double) add_double(c, 0.0, 0);
+    add_text(c, token, len, 1);
+  }
+  else if(!c.is_double) add_text(c, token, len, 1);
+  else {
+    double value;
+    const bool valid = len && parse_number(token, len, value);
+    add_double(c, valid ? value : 0.0, valid);
+  }
+}
+
+template<typename input_base_t, typename output_base_t> void basic_arrow_writer_t<input_base_t, output_base_t>::add_cell(column_t& c, double token)
+{
+  if(!schema_written) c.saw_double = 1;
+  if(c.is_double) add_double(c, token, 1);
+  if(!c.is_double || !schema_written) { char buf[32]; size_t len = dtostr(token, buf); add_text(c, buf, len, 1); }
+}
+
+template<typename input_base_t, typename output_base_t> void basic_arrow_writer_t<input_base_t, output_base_t>::process_null()
+{
+  //a null in either type, unlike an empty token which is an empty string in a utf8 column
+  column_t& c = next_column();
+  if(c.is_double) add_double(c, 0.0, 0);
+  if(!c.is_double || !schema_written) add_text(c, "", 0, 0);
+}
+
+template<typename input_base_t, typename output_base_t> void basic_arrow_writer_t<input_base_t, output_base_t>::output_schema()
+{
+  //each column keeps the half of the first batch that matches its type
+  vector<char> is_double;
+  for(typename vector<column_t>::iterator i = columns.begin(); i != columns.end(); ++i) {
+    column_t& c = *i;
+    c.is_double = c.is_double && c.saw_double;
+    if(c.is_double) { c.offsets.assign(1, 0); c.data.clear(); }
+    else { c.validity.swap(c.text_validity); c.null_count = c.text_null_count; c.values.clear(); }
+    c.text_validity.clear(); c.text_null_count = 0;
+    is_double.push_back(c.is_double);
+  }
+
+  vector<char> msg;
+  arrow_schema_message(keys, is_double, msg);
+  output_base_t::output(&msg[0], msg.size());
+  schema_written = 1;
+}
+
+template<typename input_base_t, typename output_base_t> void basic_arrow_writer_t<input_base_t, output_base_t>::process_keys()
 {
-  const size_t read_size = 32 * 1024;
+  columns.resize(keys.size());
+  for(typename vector<column_t>::iterator i = columns.begin(); i != columns.end(); ++i) {
+    column_t& c = *i;
+    c.is_double = 1; c.saw_double = 0;
+    c.validity.clear(); c.null_count = 0; c.values.clear();
+    c.text_validity.clear(); c.text_null_count = 0; c.offsets.assign(1, 0); c.data.clear();
+  }
+}
 
-  line = 0;
-  column = 0;
-  if(!buf) { buf = new char[read_size + 128]; buf_end = buf + read_size + 128; }
-  start = buf;
-  data_end = buf;
-  in_keys = 1;
-  size_t num_read; do {
-    if(data_end + read_size + 1 > buf_end) resize_buffer(buf, data_end, buf_end, read_size);
-    num_read = r.read(data_end, read_size);
-    data_end += num_read;
-    if(in_keys) process_keys(num_read == 0);
-    if(!in_keys) process(num_read == 0);
-  } while(num_read > 0);
+template<typename input_base_t, typename output_base_t> void basic_arrow_writer_t<input_base_t, output_base_t>::output_batch()
+{
+  if(!schema_written) output_schema();
 
-#ifdef TABLE_DIMENSIONS_DEBUG_PRINTS
-  cerr << "read_csv saw dimensions of " << num_keys << " by " << line << endl;
-#endif
-  this->output_stream();
+  //every buffer starts on an 8 byte boundary of the body
+  vector<int64_t> nodes;
+  vector<int64_t> buffers;
+  size_t body_len = 0;
+  for(typename vector<column_t>::const_iterator i = columns.begin(); i != columns.end(); ++i) {
+    const column_t& c = *i;
+    nodes.push_back(rows); nodes.push_back(c.null_count);
+    const size_t lens[3] = { c.null_count ? c.validity.size() : 0, c.is_double ? c.values.size() * sizeof(double) : c.offsets.size() * sizeof(int32_t), c.data.size() };
+    for(size_t b = 0; b < (c.is_double ? 2u : 3u); ++b) { buffers.push_back(body_len); buffers.push_back(lens[b]); body_len += (lens[b] + 7) & ~size_t(7); }
+  }
+
+  vector<char> msg;
+  arrow_record_batch_message(rows, nodes, buffers, body_len, msg);
+  output_base_t::output(&msg[0], msg.size());
+
+  const char zeros[8] = { 0 };
+  size_t b = 0;
+  for(typename vector<column_t>::iterator i = columns.begin(); i != columns.end(); ++i) {
+    column_t& c = *i;
+    const char* data[3] = { c.validity.empty() ? 0 : reinterpret_cast<const char*>(&c.validity[0]), c.is_double ? reinterpret_cast<const char*>(c.values.empty() ? 0 : &c.values[0]) : reinterpret_cast<const char*>(&c.offsets[0]), c.data.empty() ? 0 : &c.data[0] };
+    for(size_t d = 0; d < (c.is_double ? 2u : 3u); ++d, b += 2) {
+      const size_t len = buffers[b + 1];
+      if(len) output_base_t::output(data[d], len);
+      if(len & 7) output_base_t::output(zeros, 8 - (len & 7));
+    }
+    c.validity.clear(); c.null_count = 0; c.values.clear(); c.offsets.assign(1, 0); c.data.clear();
+  }
+  rows = 0;
+}
+
+template<typename input_base_t, typename output_base_t> void basic_arrow_writer_t<input_base_t, output_base_t>::process_line()
+{
+  if(column != columns.size()) {
+    stringstream msg; msg << "arrow_writer: a line has " << column << " columns instead of " << columns.size();
+    throw runtime_error(msg.str());
+  }
+  column = 0;
+  if(++rows == batch_rows) output_batch();
+}
 
-  return num_read;
+template<typename input_base_t, typename output_base_t> void basic_arrow_writer_t<input_base_t, output_base_t>::process_stream()
+{
+  if(column) throw runtime_error("arrow_writer saw process_stream called after process_token");
+  if(!schema_written) output_schema();
+  if(rows) output_batch();
+  const char eos[8] = { '\xff', '\xff', '\xff', '\xff', 0, 0, 0, 0 };
+  output_base_t::output(eos, sizeof(eos));
+  this->flush();
 }
 
 
@@ -1684,24 +4287,39 @@ template<typename input_base_t, typename output_base_t> void* basic_threader_t<i
   bool done = 0;
   bool inc = 0;
   while(!done) {
-    pthread_mutex_lock(&t.mutex);
     if(inc) {
-      t.read_chunk = (t.read_chunk + 1) % 8;
-      pthread_cond_signal(&t.prod_cond);
+      __atomic_store_n(&t.read_chunk, (t.read_chunk + 1) % t.chunks.size(), __ATOMIC_SEQ_CST);
+      t.wake(t.prod_cond, t.prod_waiting);
     }
     else inc = 1;
-    while(t.read_chunk == t.write_chunk) { pthread_cond_wait(&t.cons_cond, &t.mutex); }
-    pthread_mutex_unlock(&t.mutex);
+    t.wait_while(t.write_chunk, t.read_chunk, t.cons_cond, t.cons_waiting);
 
+    //tokens in a block point into the chunk, so it's flushed before the chunk is handed back
     for(char* cur = t.chunks[t.read_chunk].start; 1; ++cur) {
-      if(*cur == '\x01') { size_t len = strlen(++cur); t.output_key(cur, len); cur += len; }
-      else if(*cur == '\x02') { t.output_keys(); }
-      else if(*cur == '\x03') { t.output_token(*reinterpret_cast<double*>(++cur)); cur += sizeof(double) - 1; }
-      else if(*cur == '\x04') { t.output_line(); }
+      if(*cur == '\x01') { t.flush_out_block(); size_t len = strlen(++cur); t.output_key(cur, len); cur += len; }
+      else if(*cur == '\x02') { t.flush_out_block(); t.output_keys(); }
+      else if(*cur == '\x03') {
+        double token; memcpy(&token, ++cur, sizeof(double));
+        if(output_base_t::block_output) t.out_block.add_token(token); else t.output_token(token);
+        cur += sizeof(double) - 1;
+      }
+      else if(*cur == '\x04') { if(output_base_t::block_output) t.out_block.add_line(); else t.output_line(); }
       else if(*cur == '\x05') { break; }
       else if(*cur == '\x06') { done = 1; break; }
-      else { size_t len = strlen(cur); t.output_token(cur, len); cur += len; }
+      else if(*cur == '\x07') {
+        int64_t token; memcpy(&token, ++cur, sizeof(int64_t));
+        if(output_base_t::block_output) t.out_block.add_token(token); else t.output_token(token);
+        cur += sizeof(int64_t) - 1;
+      }
+      else if(*cur == '\x08') { if(output_base_t::block_output) t.out_block.add_null(); else t.output_null(); }
+      else {
+        if(*cur == '\x0f') ++cur;
+        size_t len = strlen(cur);
+        if(output_base_t::block_output) t.out_block.add_token(cur, len); else t.output_token(cur, len);
+        cur += len;
+      }
     }
+    t.flush_out_block();
   }
 
   t.output_stream();
@@ -1710,14 +4328,9 @@ template<typename input_base_t, typename output_base_t> void* basic_threader_t<i
 }
 
 template<typename input_base_t, typename output_base_t> basic_threader_t<input_base_t, output_base_t>::basic_threader_t() :
-  write_chunk(0), read_chunk(0), thread_created(0)
+  chunks(8), chunk_size(8 * 1024), write_chunk(0), read_chunk(0), prod_waiting(0), cons_waiting(0), thread_created(0)
 {
-  for(int c = 0; c < 8; ++c) {
-    delete[] chunks[c].start;
-    chunks[c].start = new char[8 * 1024];
-    chunks[c].end = chunks[c].start + 8 * 1024;
-  }
-  write_chunk_next = chunks[0].start;
+  alloc_chunks();
 }
 
 template<typename input_base_t, typename output_base_t> basic_threader_t<input_base_t, output_base_t>::~basic_threader_t()
@@ -1729,7 +4342,46 @@ template<typename input_base_t, typename output_base_t> basic_threader_t<input_b
     pthread_mutex_destroy(&mutex);
     thread_created = 0;
   }
-  for(int c = 0; c < 8; ++c) delete[] chunks[c].start;
+  for(typename vector<chunk_info_t>::iterator i = chunks.begin(); i != chunks.end(); ++i) delete[] (*i).start;
+}
+
+template<typename input_base_t, typename output_base_t> void basic_threader_t<input_base_t, output_base_t>::alloc_chunks()
+{
+  for(typename vector<chunk_info_t>::iterator i = chunks.begin(); i != chunks.end(); ++i) {
+    delete[] (*i).start;
+    (*i).start = new char[chunk_size];
+    (*i).end = (*i).start + chunk_size;
+  }
+  write_chunk = 0;
+  write_chunk_next = chunks[0].start;
+  read_chunk = 0;
+}
+
+template<typename input_base_t, typename output_base_t> void basic_threader_t<input_base_t, output_base_t>::set_chunks(size_t count, size_t size)
+{
+  if(thread_created) throw runtime_error("can't change threader chunks while running");
+  if(count < 2 || size < 64) throw runtime_error("invalid threader chunks");
+  for(typename vector<chunk_info_t>::iterator i = chunks.begin(); i != chunks.end(); ++i) delete[] (*i).start;
+  chunks.assign(count, chunk_info_t());
+  chunk_size = size;
+  alloc_chunks();
+}
+
+template<typename input_base_t, typename output_base_t> void basic_threader_t<input_base_t, output_base_t>::wait_while(const size_t& index, size_t value, pthread_cond_t& cond, int& waiting)
+{
+  //the other side is usually only a chunk behind, so spin a little before sleeping
+  for(int spin = 0; spin < 4096; ++spin) {
+    if(__atomic_load_n(&index, __ATOMIC_SEQ_CST) != value) return;
+#if defined(__SSE2__)
+    _mm_pause();
+#endif
+  }
+
+  pthread_mutex_lock(&mutex);
+  __atomic_store_n(&waiting, 1, __ATOMIC_SEQ_CST);
+  while(__atomic_load_n(&index, __ATOMIC_SEQ_CST) == value) pthread_cond_wait(&cond, &mutex);
+  __atomic_store_n(&waiting, 0, __ATOMIC_SEQ_CST);
+  pthread_mutex_unlock(&mutex);
 }
 
 template<typename input_base_t, typename output_base_t> void basic_threader_t<input_base_t, output_base_t>::resize_write_chunk(size_t min_size)
@@ -1744,37 +4396,41 @@ template<typename input_base_t, typename output_base_t> void basic_threader_t<in
 {
     if(term) *write_chunk_next++ = '\x05';
 
-    pthread_mutex_lock(&mutex);
-    while((write_chunk + 1) % 8 == read_chunk)
-      pthread_cond_wait(&prod_cond, &mutex);
-    write_chunk = (write_chunk + 1) % 8;
-    pthread_cond_signal(&cons_cond);
-    pthread_mutex_unlock(&mutex);
+    const size_t next = (write_chunk + 1) % chunks.size();
+    wait_while(read_chunk, next, prod_cond, prod_waiting);
+    __atomic_store_n(&write_chunk, next, __ATOMIC_SEQ_CST);
+    wake(cons_cond, cons_waiting);
 
-    write_chunk_next = chunks[write_chunk].start;
+    write_chunk_next = chunks[next].start;
+}
+
+template<typename input_base_t, typename output_base_t> void basic_threader_t<input_base_t, output_base_t>::create_thread()
+{
+  pthread_mutex_init(&mutex, 0);
+  pthread_cond_init(&prod_cond, 0);
+  pthread_cond_init(&cons_cond, 0);
+  pthread_create(&thread, 0, basic_threader_t<input_base_t, output_base_t>::threader_main, this);
+  thread_created = 1;
 }
 
 template<typename input_base_t, typename output_base_t> void basic_threader_t<input_base_t, output_base_t>::reinit_state(int more_passes) {
-  for(int c = 0; c < 8; ++c) {
-    delete[] chunks[c].start;
-    chunks[c].start = new char[8 * 1024];
-    chunks[c].end = chunks[c].start + 8 * 1024;
-  }
-  write_chunk = 0;
-  write_chunk_next = chunks[0].start;
-  read_chunk = 0;
+  alloc_chunks();
   this->reinit_output_state_if(more_passes);
 }
 
-template<typename input_base_t, typename output_base_t> void basic_threader_t<input_base_t, output_base_t>::process_key(const char* token, size_t len)
+template<typename input_base_t, typename output_base_t> const vector<bool>* basic_threader_t<input_base_t, output_base_t>::get_skip_columns()
 {
-  if(!thread_created) {
-    pthread_mutex_init(&mutex, 0);
-    pthread_cond_init(&prod_cond, 0);
-    pthread_cond_init(&cons_cond, 0);
-    pthread_create(&thread, 0, basic_threader_t<input_base_t, output_base_t>::threader_main, this);
-    thread_created = 1;
+  //the out answers from the keys it has seen, so the consumer catches up before it's asked
+  if(thread_created) {
+    inc_write_chunk();
+    for(size_t r; (r = __atomic_load_n(&read_chunk, __ATOMIC_SEQ_CST)) != write_chunk;) wait_while(read_chunk, r, prod_cond, prod_waiting);
   }
+  return this->output_skip_columns();
+}
+
+template<typename input_base_t, typename output_base_t> void basic_threader_t<input_base_t, output_base_t>::process_key(const char* token, size_t len)
+{
+  if(!thread_created) create_thread();
 
   if(size_t(chunks[write_chunk].end - write_chunk_next) < len + 3) {
     if(write_chunk_next == chunks[write_chunk].start) resize_write_chunk(len + 3);
@@ -1795,31 +4451,21 @@ template<typename input_base_t, typename output_base_t> void basic_threader_t<in
 
 template<typename input_base_t, typename output_base_t> void basic_threader_t<input_base_t, output_base_t>::process_token(const char* token, size_t len)
 {
-  if(!thread_created) {
-    pthread_mutex_init(&mutex, 0);
-    pthread_cond_init(&prod_cond, 0);
-    pthread_cond_init(&cons_cond, 0);
-    pthread_create(&thread, 0, basic_threader_t<input_base_t, output_base_t>::threader_main, this);
-    thread_created = 1;
-  }
+  if(!thread_created) create_thread();
 
-  if(size_t(chunks[write_chunk].end - write_chunk_next) < len + 2) {
-    if(write_chunk_next == chunks[write_chunk].start) resize_write_chunk(len + 2);
+  const size_t tag = string_tag_len(token, len);
+  if(size_t(chunks[write_chunk].end - write_chunk_next) < len + tag + 2) {
+    if(write_chunk_next == chunks[write_chunk].start) resize_write_chunk(len + tag + 2);
     else inc_write_chunk();
   }
+  if(tag) *write_chunk_next++ = '\x0f';
   memcpy(write_chunk_next, token, len); write_chunk_next += len;
   *write_chunk_next++ = '\0';
 }
 
 template<typename input_base_t, typename output_base_t> void basic_threader_t<input_base_t, output_base_t>::process_token(double token)
 {
-  if(!thread_created) {
-    pthread_mutex_init(&mutex, 0);
-    pthread_cond_init(&prod_cond, 0);
-    pthread_cond_init(&cons_cond, 0);
-    pthread_create(&thread, 0, basic_threader_t<input_base_t, output_base_t>::threader_main, this);
-    thread_created = 1;
-  }
+  if(!thread_created) create_thread();
 
   if(size_t(chunks[write_chunk].end - write_chunk_next) < size_t(sizeof(double) + 2)) inc_write_chunk();
   *write_chunk_next++ = '\x03';
@@ -1827,6 +4473,24 @@ template<typename input_base_t, typename output_base_t> void basic_threader_t<in
   write_chunk_next += sizeof(double);
 }
 
+template<typename input_base_t, typename output_base_t> void basic_threader_t<input_base_t, output_base_t>::process_token(int64_t token)
+{
+  if(!thread_created) create_thread();
+
+  if(size_t(chunks[write_chunk].end - write_chunk_next) < size_t(sizeof(int64_t) + 2)) inc_write_chunk();
+  *write_chunk_next++ = '\x07';
+  memcpy(write_chunk_next, &token, sizeof(int64_t));
+  write_chunk_next += sizeof(int64_t);
+}
+
+template<typename input_base_t, typename output_base_t> void basic_threader_t<input_base_t, output_base_t>::process_null()
+{
+  if(!thread_created) create_thread();
+
+  if(chunks[write_chunk].end - write_chunk_next < 2) inc_write_chunk();
+  *write_chunk_next++ = '\x08';
+}
+
 template<typename input_base_t, typename output_base_t> void basic_threader_t<input_base_t, output_base_t>::process_line()
 {
   if(!thread_created) { this->output_line(); return; }
@@ -1835,6 +4499,12 @@ template<typename input_base_t, typename output_base_t> void basic_threader_t<in
   *write_chunk_next++ = '\x04';
 }
 
+template<typename input_base_t, typename output_base_t> void basic_threader_t<input_base_t, output_base_t>::process_block(const row_block_t& block)
+{
+  direct_pass_t<basic_threader_t> d(*this);
+  block.replay(d);
+}
+
 template<typename input_base_t, typename output_base_t> void basic_threader_t<input_base_t, output_base_t>::process_stream()
 {
   if(!thread_created) { this->output_stream(); return; }
@@ -1850,6 +4520,176 @@ template<typename input_base_t, typename output_base_t> void basic_threader_t<in
 }
 
 
+////////////////////////////////////////////////////////////////////////////////////////////////
+// parallel_map
+////////////////////////////////////////////////////////////////////////////////////////////////
+
+template<typename pass_t> void row_buffer_t::replay(pass_t& out) const
+{
+  for(const char* p = buf.empty() ? 0 : &buf[0], *end = p + buf.size(); p < end;) {
+    const char tag = *p++;
+    if(tag == 'd') { double token; memcpy(&token, p, sizeof(double)); p += sizeof(double); out.process_token(token); }
+    else if(tag == 'i') { int64_t token; memcpy(&token, p, sizeof(int64_t)); p += sizeof(int64_t); out.process_token(token); }
+    else if(tag == 'n') pass_null(out);
+    else if(tag == 'l') out.process_line();
+    else if(tag == 'K') out.process_keys();
+    else {
+      size_t len; memcpy(&len, p, sizeof(size_t)); p += sizeof(size_t);
+      if(tag == 's') out.process_token(p, len);
+      else out.process_key(p, len);
+      p += len;
+    }
+  }
+}
+
+template<typename input_base_t, typename output_base_t, template<typename> class pass_t> void* basic_parallel_map_t<input_base_t, output_base_t, pass_t>::worker_main(void* data)
+{
+  worker_t& w = *static_cast<worker_t*>(data);
+
+  while(1) {
+    pthread_mutex_lock(&w.mutex);
+    while(w.state != WS_QUEUED && !w.quit) pthread_cond_wait(&w.job_cond, &w.mutex);
+    const bool quit = w.state != WS_QUEUED;
+    pthread_mutex_unlock(&w.mutex);
+    if(quit) break;
+
+    bool error = 0;
+    string error_msg;
+    w.pass.get_out().buf.clear();
+    try { w.in.replay(w.pass); }
+    catch(exception& e) { error = 1; error_msg = e.what(); }
+    catch(...) { error = 1; error_msg = "parallel_map worker failed"; }
+
+    pthread_mutex_lock(&w.mutex);
+    w.state = WS_DONE;
+    if(error) { w.error = 1; w.error_msg = error_msg; }
+    pthread_cond_signal(&w.done_cond);
+    pthread_mutex_unlock(&w.mutex);
+  }
+
+  return 0;
+}
+
+template<typename input_base_t, typename output_base_t, template<typename> class pass_t> basic_parallel_map_t<input_base_t, output_base_t, pass_t>::basic_parallel_map_t() :
+  configure(0), configure_data(0), handed_out(0), batch_rows(1024), rows(0), next_batch(0), next_output(0)
+{
+#ifdef _WIN32
+  SYSTEM_INFO si; GetSystemInfo(&si);
+  set_workers(si.dwNumberOfProcessors);
+#else
+  const long cores = sysconf(_SC_NPROCESSORS_ONLN);
+  set_workers(cores > 0 ? cores : 1);
+#endif
+}
+
+template<typename input_base_t, typename output_base_t, template<typename> class pass_t> void basic_parallel_map_t<input_base_t, output_base_t, pass_t>::set_workers(size_t count)
+{
+  if(!count) throw runtime_error("parallel_map needs at least one worker");
+  if(handed_out) throw runtime_error("parallel_map: set_workers would drop the copies set up through get_worker");
+  stop_workers();
+  for(typename vector<worker_t*>::iterator i = workers.begin(); i != workers.end(); ++i) delete *i;
+  workers.clear();
+  for(size_t i = 0; i < count; ++i) { workers.push_back(new worker_t); if(configure) configure(workers.back()->pass, i, configure_data); }
+}
+
+template<typename input_base_t, typename output_base_t, template<typename> class pass_t> void basic_parallel_map_t<input_base_t, output_base_t, pass_t>::configure_workers(void (*configure)(pass_t<row_buffer_t>& pass, size_t worker, void* data), void* data)
+{
+  this->configure = configure;
+  configure_data = data;
+  for(size_t i = 0; i < workers.size(); ++i) configure(workers[i]->pass, i, data);
+}
+
+template<typename input_base_t, typename output_base_t, template<typename> class pass_t> void basic_parallel_map_t<input_base_t, output_base_t, pass_t>::reinit_state(int more_passes)
+{
+  stop_workers();
+  for(typename vector<worker_t*>::iterator i = workers.begin(); i != workers.end(); ++i) (*i)->pass.reinit_state();
+  batch.buf.clear(); rows = 0; next_batch = 0; next_output = 0;
+  this->reinit_output_state_if(more_passes);
+}
+
+template<typename input_base_t, typename output_base_t, template<typename> class pass_t> const vector<bool>* basic_parallel_map_t<input_base_t, output_base_t, pass_t>::get_skip_columns()
+{
+  const vector<bool>* skip_columns = workers[0]->pass.get_skip_columns();
+  for(size_t i = 1; i < workers.size(); ++i) workers[i]->pass.get_skip_columns();
+  return skip_columns;
+}
+
+template<typename input_base_t, typename output_base_t, template<typename> class pass_t> void basic_parallel_map_t<input_base_t, output_base_t, pass_t>::process_keys()
+{
+  //every copy sees the keys, only the first one's are passed on
+  for(typename vector<worker_t*>::iterator i = workers.begin(); i != workers.end(); ++i) { (*i)->pass.process_keys(); if(i != workers.begin()) (*i)->pass.get_out().buf.clear(); }
+  output_t out(*this);
+  workers[0]->pass.get_out().replay(out);
+  workers[0]->pass.get_out().buf.clear();
+  batch.buf.clear(); rows = 0; next_batch = 0; next_output = 0;
+}
+
+template<typename input_base_t, typename output_base_t, template<typename> class pass_t> void basic_parallel_map_t<input_base_t, output_base_t, pass_t>::collect(worker_t& w)
+{
+  pthread_mutex_lock(&w.mutex);
+  while(w.state == WS_QUEUED) pthread_cond_wait(&w.done_cond, &w.mutex);
+  const bool done = w.state == WS_DONE;
+  w.state = WS_IDLE;
+  pthread_mutex_unlock(&w.mutex);
+  if(w.error) { w.error = 0; throw runtime_error(w.error_msg); }
+  if(!done) return;
+
+  output_t out(*this);
+  w.pass.get_out().replay(out);
+  w.pass.get_out().buf.clear();
+  ++next_output;
+}
+
+template<typename input_base_t, typename output_base_t, template<typename> class pass_t> void basic_parallel_map_t<input_base_t, output_base_t, pass_t>::dispatch()
+{
+  //batches go round robin, so a worker's last batch is the oldest one not yet output
+  worker_t& w = *workers[next_batch % workers.size()];
+  collect(w);
+
+  w.in.buf.swap(batch.buf);
+  batch.buf.clear();
+  rows = 0;
+  if(!w.thread_created) {
+    if(pthread_create(&w.thread, 0, basic_parallel_map_t<input_base_t, output_base_t, pass_t>::worker_main, &w)) throw runtime_error("can't create parallel_map worker thread");
+    w.thread_created = 1;
+  }
+  pthread_mutex_lock(&w.mutex);
+  w.state = WS_QUEUED;
+  pthread_cond_signal(&w.job_cond);
+  pthread_mutex_unlock(&w.mutex);
+  ++next_batch;
+}
+
+template<typename input_base_t, typename output_base_t, template<typename> class pass_t> void basic_parallel_map_t<input_base_t, output_base_t, pass_t>::stop_workers()
+{
+  for(typename vector<worker_t*>::iterator i = workers.begin(); i != workers.end(); ++i) {
+    worker_t& w = **i;
+    if(!w.thread_created) continue;
+    pthread_mutex_lock(&w.mutex);
+    w.quit = 1;
+    pthread_cond_signal(&w.job_cond);
+    pthread_mutex_unlock(&w.mutex);
+    pthread_join(w.thread, 0);
+    w.thread_created = 0; w.quit = 0; w.state = WS_IDLE; w.error = 0;
+  }
+}
+
+template<typename input_base_t, typename output_base_t, template<typename> class pass_t> void basic_parallel_map_t<input_base_t, output_base_t, pass_t>::process_stream()
+{
+  if(rows) dispatch();
+  for(; next_output < next_batch;) collect(*workers[next_output % workers.size()]);
+  stop_workers();
+
+  output_t out(*this);
+  for(typename vector<worker_t*>::iterator i = workers.begin(); i != workers.end(); ++i) {
+    (*i)->pass.process_stream();
+    (*i)->pass.get_out().replay(out);
+    (*i)->pass.get_out().buf.clear();
+  }
+  this->output_stream();
+}
+
+
 ////////////////////////////////////////////////////////////////////////////////////////////////
 // subset_tee
 ////////////////////////////////////////////////////////////////////////////////////////////////
@@ -1996,14 +4836,16 @@ template<typename input_base_t> void basic_ordered_tee_t<input_base_t>::process_
 {
   if(!out.size()) throw runtime_error("ordered_tee::process_token no outs");
   out[0]->process_token(token, len);
-  if(!next || next + len + 2 > end) {
+  const size_t tag = string_tag_len(token, len);
+  if(!next || next + len + tag + 2 > end) {
     if(next) *next++ = '\x05';
     size_t cap = 256 * 1024;
-    if(cap < len + 2) cap = len + 2;
+    if(cap < len + tag + 2) cap = len + tag + 2;
     data.push_back(new char[cap]);
     next = data.back();
     end = data.back() + cap;
   }
+  if(tag) *next++ = '\x0f';
   memcpy(next, token, len); next += len;
   *next++ = '\0';
 }
@@ -2024,6 +4866,36 @@ template<typename input_base_t> void basic_ordered_tee_t<input_base_t>::process_
   next += sizeof(double);
 }
 
+template<typename input_base_t> void basic_ordered_tee_t<input_base_t>::process_token(int64_t token)
+{
+  if(!out.size()) throw runtime_error("ordered_tee::process_token no outs");
+  out[0]->process_token(token);
+  if(!next || next + 2 + sizeof(int64_t) > end) {
+    if(next) *next++ = '\x05';
+    size_t cap = 256 * 1024;
+    data.push_back(new char[cap]);
+    next = data.back();
+    end = data.back() + cap;
+  }
+  *next++ = '\x06';
+  memcpy(next, &token, sizeof(int64_t));
+  next += sizeof(int64_t);
+}
+
+template<typename input_base_t> void basic_ordered_tee_t<input_base_t>::process_null()
+{
+  if(!out.size()) throw runtime_error("ordered_tee::process_null no outs");
+  out[0]->process_null();
+  if(!next || next + 2 > end) {
+    if(next) *next++ = '\x05';
+    size_t cap = 256 * 1024;
+    data.push_back(new char[cap]);
+    next = data.back();
+    end = data.back() + cap;
+  }
+  *next++ = '\x07';
+}
+
 template<typename input_base_t> void basic_ordered_tee_t<input_base_t>::process_line()
 {
   if(!out.size()) throw runtime_error("ordered_tee::process_line no outs");
@@ -2048,7 +4920,9 @@ template<typename input_base_t> void basic_ordered_tee_t<input_base_t>::process_
         else if(*p == '\x02') { (*oi)->process_keys(); ++p; }
         else if(*p == '\x03') { (*oi)->process_token(*reinterpret_cast<const double*>(++p)); p += sizeof(double); }
         else if(*p == '\x04') { (*oi)->process_line(); ++p; }
-        else { size_t len = strlen(p); (*oi)->process_token(p, len); p += len + 1; }
+        else if(*p == '\x06') { int64_t token; memcpy(&token, ++p, sizeof(int64_t)); (*oi)->process_token(token); p += sizeof(int64_t); }
+        else if(*p == '\x07') { (*oi)->process_null(); ++p; }
+        else { if(*p == '\x0f') ++p; size_t len = strlen(p); (*oi)->process_token(p, len); p += len + 1; }
       }
       if(last_out) delete[] *i;
     }
@@ -2134,6 +5008,7 @@ template<typename input_base_t, typename output_base_t> void basic_stacker_t<inp
   stack_keys.clear();
   actions.clear();
   last_leave = 0;
+  skipping = 0;
 
   column = 0;
   stack_column = 0;
@@ -2182,12 +5057,35 @@ template<typename input_base_t, typename output_base_t> void basic_stacker_t<inp
 
 template<typename input_base_t, typename output_base_t> void basic_stacker_t<input_base_t, output_base_t>::process_keys()
 {
+  //removed columns won't come, so actions and last_leave are renumbered over the columns that will
+  if(skipping) {
+    size_t kept = 0;
+    size_t new_last_leave = 0;
+    for(size_t i = 0; i < actions.size(); ++i) {
+      if(actions[i] == ST_REMOVE) continue;
+      if(i == last_leave) new_last_leave = kept;
+      actions[kept++] = actions[i];
+    }
+    actions.resize(kept);
+    last_leave = new_last_leave;
+  }
+
   this->output_key("keyword", 7);
   this->output_key("data", 4);
   this->output_keys();
   this->process_line();
 }
 
+template<typename input_base_t, typename output_base_t> const vector<bool>* basic_stacker_t<input_base_t, output_base_t>::get_skip_columns()
+{
+  //once answered the mask is kept, actions are renumbered in process_keys
+  if(!skipping) {
+    skip_columns.assign(actions.size(), 0);
+    for(size_t i = 0; i < actions.size(); ++i) if(actions[i] == ST_REMOVE) skip_columns[i] = skipping = 1;
+  }
+  return skipping ? &skip_columns : 0;
+}
+
 template<typename input_base_t, typename output_base_t> void basic_stacker_t<input_base_t, output_base_t>::process_token(const char* token, size_t len)
 {
   if(column >= actions.size()) throw runtime_error("too many columns");
@@ -2452,15 +5350,15 @@ template<typename input_base_t, typename output_base_t> void basic_splitter_t<in
 template<typename input_base_t, typename output_base_t> void basic_splitter_t<input_base_t, output_base_t>::process_stream()
 {
   for(vector<string>::const_iterator i = group_keys.begin(); i != group_keys.end(); ++i)
-    this->output_token((*i).c_str(), (*i).size());
+    this->output_key((*i).c_str(), (*i).size());
   {
     vector<char*> osk(out_split_keys.size());
     for(map<char*, size_t, cstr_less>::const_iterator i = out_split_keys.begin(); i != out_split_keys.end(); ++i)
       osk[(*i).second] = (*i).first;
     for(vector<char*>::const_iterator i = osk.begin(); i != osk.end(); ++i)
-      this->output_token(*i, strlen(*i));
+      this->output_key(*i, strlen(*i));
   }
-  this->output_line();
+  this->output_keys();
 
   map<char*, size_t, cstr_less>::size_type num_out_split_keys = out_split_keys.size();
   for(map<char*, size_t, cstr_less>::const_iterator i = out_split_keys.begin(); i != out_split_keys.end(); ++i)
@@ -2569,7 +5467,7 @@ template<typename input_base_t, typename output_base_t> void basic_sorter_t<inpu
 
   size_t index = numeric_limits<size_t>::max();
   for(size_t i = 0; i < sorts.size(); ++i) {
-    if(!sorts[i].key.compare(token)) { index = i; ++sorts_found; break; }
+    if(!sorts[i].key.compare(0, string::npos, token, len)) { index = i; ++sorts_found; break; }
   }
   columns.push_back(index);
 
@@ -2797,7 +5695,7 @@ template<typename input_base_t, typename output_base_t> void basic_row_joiner_t<
     size_t c = column;
     for(size_t t = 0; t < table; ++t)
       c += num_columns[t];
-    if(keys[c].compare(token) && keys[c].compare(stoken + " of " + table_name[table]))
+    if(keys[c].compare(stoken) && keys[c].compare(stoken + " of " + table_name[table]))
       throw runtime_error("column keys don't match previous tables");
     ++column;
   }
@@ -2817,16 +5715,18 @@ template<typename input_base_t, typename output_base_t> void basic_row_joiner_t<
 template<typename input_base_t, typename output_base_t> void basic_row_joiner_t<input_base_t, output_base_t>::process_token(const char* token, size_t len)
 {
   data_t& d = data[table];
-  if(!d.next || (len + 2) > size_t(d.end - d.next)) {
+  const size_t tag = string_tag_len(token, len);
+  if(!d.next || (len + tag + 2) > size_t(d.end - d.next)) {
     if(d.next) *d.next++ = '\x03';
     size_t cap = 256 * 1024;
-    if(cap < len + 2) cap = len + 2;
+    if(cap < len + tag + 2) cap = len + tag + 2;
     d.data.push_back(new char[cap]);
     d.next = d.data.back();
     d.end = d.data.back() + cap;
   }
-  memcpy(d.next, token, len + 1);
-  d.next += len + 1;
+  if(tag) *d.next++ = '\x0f';
+  memcpy(d.next, token, len); d.next += len;
+  *d.next++ = '\0';
 }
 
 template<typename input_base_t, typename output_base_t> void basic_row_joiner_t<input_base_t, output_base_t>::process_token(double token)
@@ -2844,6 +5744,34 @@ template<typename input_base_t, typename output_base_t> void basic_row_joiner_t<
   d.next += sizeof(double);
 }
 
+template<typename input_base_t, typename output_base_t> void basic_row_joiner_t<input_base_t, output_base_t>::process_token(int64_t token)
+{
+  data_t& d = data[table];
+  if(!d.next || (sizeof(int64_t) + 2) > size_t(d.end - d.next)) {
+    if(d.next) *d.next++ = '\x03';
+    size_t cap = 256 * 1024;
+    d.data.push_back(new char[cap]);
+    d.next = d.data.back();
+    d.end = d.data.back() + cap;
+  }
+  *d.next++ = '\x02';
+  memcpy(d.next, &token, sizeof(int64_t));
+  d.next += sizeof(int64_t);
+}
+
+template<typename input_base_t, typename output_base_t> void basic_row_joiner_t<input_base_t, output_base_t>::process_null()
+{
+  data_t& d = data[table];
+  if(!d.next || 2 > size_t(d.end - d.next)) {
+    if(d.next) *d.next++ = '\x03';
+    size_t cap = 256 * 1024;
+    d.data.push_back(new char[cap]);
+    d.next = d.data.back();
+    d.end = d.data.back() + cap;
+  }
+  *d.next++ = '\x04';
+}
+
 template<typename input_base_t, typename output_base_t> void basic_row_joiner_t<input_base_t, output_base_t>::process_stream() { ++table; }
 
 template<typename input_base_t, typename output_base_t> void basic_row_joiner_t<input_base_t, output_base_t>::process_lines()
@@ -2904,7 +5832,14 @@ template<typename input_base_t, typename output_base_t> void basic_row_joiner_t<
           this->output_token(*reinterpret_cast<const double*>(++d.next));
           d.next += sizeof(double);
         }
+        else if(*d.next == '\x02') {
+          int64_t token; memcpy(&token, ++d.next, sizeof(int64_t));
+          this->output_token(token);
+          d.next += sizeof(int64_t);
+        }
+        else if(*d.next == '\x04') { this->output_null(); ++d.next; }
         else {
+          if(*d.next == '\x0f') ++d.next;
           size_t len = strlen(d.next);
           this->output_token(d.next, len);
           d.next += len + 1;
@@ -2956,14 +5891,16 @@ template<typename input_base_t, typename output_base_t> void basic_col_pruner_t<
 
 template<typename input_base_t, typename output_base_t> void basic_col_pruner_t<input_base_t, output_base_t>::process_key(const char* token, size_t len)
 {
-  if(!next || next + len + 2 > end) {
+  const size_t tag = string_tag_len(token, len);
+  if(!next || next + len + tag + 2 > end) {
     if(next) *next++ = '\x03';
     size_t cap = 256 * 1024;
-    if(cap < len + 2) cap = len + 2;
+    if(cap < len + tag + 2) cap = len + tag + 2;
     data.push_back(new char[cap]);
     next = data.back();
     end = data.back() + cap;
   }
+  if(tag) *next++ = '\x0f';
   memcpy(next, token, len); next += len;
   *next++ = '\0';
   ++column;
@@ -2983,21 +5920,23 @@ template<typename input_base_t, typename output_base_t> void basic_col_pruner_t<
 {
   if(passthrough) { this->output_token(token, len); return; }
 
-  if(token[0]) {
+  if(len) {
     if(!(has_data[column / 32] & (1 << (column % 32)))) {
       has_data[column / 32] |= 1 << (column % 32);
       ++columns_with_data;
     }
   }
 
-  if(!next || next + len + 2 > end) {
+  const size_t tag = string_tag_len(token, len);
+  if(!next || next + len + tag + 2 > end) {
     if(next) *next++ = '\x03';
     size_t cap = 256 * 1024;
-    if(cap < len + 2) cap = len + 2;
+    if(cap < len + tag + 2) cap = len + tag + 2;
     data.push_back(new char[cap]);
     next = data.back();
     end = data.back() + cap;
   }
+  if(tag) *next++ = '\x0f';
   memcpy(next, token, len); next += len;
   *next++ = '\0';
   ++column;
@@ -3027,6 +5966,43 @@ template<typename input_base_t, typename output_base_t> void basic_col_pruner_t<
   ++column;
 }
 
+template<typename input_base_t, typename output_base_t> void basic_col_pruner_t<input_base_t, output_base_t>::process_token(int64_t token)
+{
+  if(passthrough) { this->output_token(token); return; }
+
+  if(!(has_data[column / 32] & (1 << (column % 32)))) {
+    has_data[column / 32] |= 1 << (column % 32);
+    ++columns_with_data;
+  }
+
+  if(!next || next + sizeof(int64_t) + 2 > end) {
+    if(next) *next++ = '\x03';
+    size_t cap = 256 * 1024;
+    data.push_back(new char[cap]);
+    next = data.back();
+    end = data.back() + cap;
+  }
+  *next++ = '\x02';
+  memcpy(next, &token, sizeof(int64_t));
+  next += sizeof(int64_t);
+  ++column;
+}
+
+template<typename input_base_t, typename output_base_t> void basic_col_pruner_t<input_base_t, output_base_t>::process_null()
+{
+  if(passthrough) { this->output_null(); return; }
+
+  if(!next || next + 2 > end) {
+    if(next) *next++ = '\x03';
+    size_t cap = 256 * 1024;
+    data.push_back(new char[cap]);
+    next = data.back();
+    end = data.back() + cap;
+  }
+  *next++ = '\x04';
+  ++column;
+}
+
 template<typename input_base_t, typename output_base_t> void basic_col_pruner_t<input_base_t, output_base_t>::process_line()
 {
   if(passthrough) { this->output_line(); return; }
@@ -3039,14 +6015,17 @@ template<typename input_base_t, typename output_base_t> void basic_col_pruner_t<
       const char* p = *i;
       while(*p != '\03') {
         if(*p == '\x01') { this->output_token(*reinterpret_cast<const double*>(++p)); p += sizeof(double); }
+        else if(*p == '\x02') { int64_t token; memcpy(&token, ++p, sizeof(int64_t)); this->output_token(token); p += sizeof(int64_t); }
+        else if(*p == '\x04') { this->output_null(); ++p; }
         else {
+          if(*p == '\x0f') ++p;
           size_t len = strlen(p);
           if(!line) this->output_key(p, len);
           else this->output_token(p, len);
           p += len + 1;
         }
         if(++c >= num_columns) {
-          if(!line) this->output_keys();
+          if(!line++) this->output_keys();
           else this->output_line();
           c = 0;
         }
@@ -3062,6 +6041,15 @@ template<typename input_base_t, typename output_base_t> void basic_col_pruner_t<
   column = 0;
 }
 
+template<typename input_base_t, typename output_base_t> void basic_col_pruner_t<input_base_t, output_base_t>::process_block(const row_block_t& block)
+{
+  //once every column has shown data the block goes straight through
+  if(passthrough) { this->output_block(block); return; }
+
+  direct_pass_t<basic_col_pruner_t> d(*this);
+  block.replay(d);
+}
+
 template<typename input_base_t, typename output_base_t> void basic_col_pruner_t<input_base_t, output_base_t>::process_stream()
 {
   if(passthrough) { this->output_stream(); return; }
@@ -3075,7 +6063,10 @@ template<typename input_base_t, typename output_base_t> void basic_col_pruner_t<
     while(*p != '\03') {
       if(has_data[c / 32] & (1 << (c % 32))) {
         if(*p == '\x01') { this->output_token(*reinterpret_cast<const double*>(++p)); p += sizeof(double); }
+        else if(*p == '\x02') { int64_t token; memcpy(&token, ++p, sizeof(int64_t)); this->output_token(token); p += sizeof(int64_t); }
+        else if(*p == '\x04') { this->output_null(); ++p; }
         else {
+          if(*p == '\x0f') ++p;
           size_t len = strlen(p);
           if(!line) this->output_key(p, len);
           else this->output_token(p, len);
@@ -3084,6 +6075,8 @@ template<typename input_base_t, typename output_base_t> void basic_col_pruner_t<
       }
       else {
         if(*p == '\x01') { p += 1 + sizeof(double); }
+        else if(*p == '\x02') { p += 1 + sizeof(int64_t); }
+        else if(*p == '\x04') { ++p; }
         else { while(*p) ++p; ++p; }
       }
       if(++c >= num_columns) {
@@ -3257,8 +6250,8 @@ template<typename input_base_t, typename output_base_t> void basic_summarizer_t<
     for(cfi = column_flags.begin(); cfi != column_flags.end(); ++cfi) {
       if(!((*cfi) & 0xFFFFFFFC)) continue;
 
-      if((*cfi) & SUM_MISSING) { this->output_token((*d).missing); }
-      if((*cfi) & SUM_COUNT) { this->output_token((*d).count); }
+      if((*cfi) & SUM_MISSING) { this->output_token(int64_t((*d).missing)); }
+      if((*cfi) & SUM_COUNT) { this->output_token(int64_t((*d).count)); }
       if((*cfi) & SUM_SUM) { this->output_token((*d).count ? (*d).sum : numeric_limits<double>::quiet_NaN()); }
       if((*cfi) & SUM_MIN) { this->output_token((*d).count ? (*d).min : numeric_limits<double>::quiet_NaN()); }
       if((*cfi) & SUM_MAX) { this->output_token((*d).count ? (*d).max : numeric_limits<double>::quiet_NaN()); }
@@ -3313,6 +6306,7 @@ template<typename input_base_t, typename output_base_t> void basic_summarizer_t<
 {
   column_flags.clear();
   num_data_columns = 0;
+  skipping = 0;
   delete[] values; values = 0;
   delete[] pre_sorted_group_tokens; pre_sorted_group_tokens = new char[2048];
   pre_sorted_group_tokens_next = pre_sorted_group_tokens;
@@ -3416,13 +6410,25 @@ template<typename input_base_t, typename output_base_t> void basic_summarizer_t<
     p += len;
   }
   this->output_keys();
+  if(skipping) column_flags.erase(remove(column_flags.begin(), column_flags.end(), uint32_t(0)), column_flags.end());
   values = new double[num_data_columns];
+  nulls.assign(num_data_columns, 0);
   cfi = column_flags.begin();
   vi = values;
   pre_sorted_group_tokens_next = pre_sorted_group_tokens;
   group_tokens_next = group_tokens;
 }
 
+template<typename input_base_t, typename output_base_t> const vector<bool>* basic_summarizer_t<input_base_t, output_base_t>::get_skip_columns()
+{
+  //once answered the mask is kept, the flags of skipped columns are dropped in process_keys
+  if(!skipping) {
+    skip_columns.assign(column_flags.size(), 0);
+    for(size_t i = 0; i < column_flags.size(); ++i) if(!column_flags[i]) skip_columns[i] = skipping = 1;
+  }
+  return skipping ? &skip_columns : 0;
+}
+
 template<typename input_base_t, typename output_base_t> void basic_summarizer_t<input_base_t, output_base_t>::process_token(const char* token, size_t len)
 {
   const uint32_t& flags = *cfi;
@@ -3437,28 +6443,59 @@ template<typename input_base_t, typename output_base_t> void basic_summarizer_t<
     *group_tokens_next++ = '\0';
   }
   if(flags & 0xFFFFFFFC) {
-    if(!len) { *vi = numeric_limits<double>::quiet_NaN(); }
-    else { *vi = strtod(token, 0); }
+    if(!len) nulls[vi - values] = 1;
+    else *vi = strtod(token, 0);
     ++vi;
   }
   ++cfi;
 }
 
+template<typename input_base_t, typename output_base_t> void basic_summarizer_t<input_base_t, output_base_t>::process_null()
+{
+  const uint32_t& flags = *cfi;
+  if(flags & 1) {
+    if(pre_sorted_group_tokens_next >= pre_sorted_group_tokens_end) resize_buffer(pre_sorted_group_tokens, pre_sorted_group_tokens_next, pre_sorted_group_tokens_end);
+    *pre_sorted_group_tokens_next++ = '\0';
+  }
+  else if(flags & 2) {
+    if(group_tokens_next >= group_tokens_end) resize_buffer(group_tokens, group_tokens_next, group_tokens_end);
+    *group_tokens_next++ = '\0';
+  }
+  if(flags & 0xFFFFFFFC) nulls[vi++ - values] = 1;
+  ++cfi;
+}
+
 template<typename input_base_t, typename output_base_t> void basic_summarizer_t<input_base_t, output_base_t>::process_token(double token)
 {
   const uint32_t& flags = *cfi;
   if(flags & 1) {
     if(pre_sorted_group_tokens_next + 31 >= pre_sorted_group_tokens_end) resize_buffer(pre_sorted_group_tokens, pre_sorted_group_tokens_next, pre_sorted_group_tokens_end, 32);
-    pre_sorted_group_tokens_next += dtostr(token, pre_sorted_group_tokens_next) + 1;
+    pre_sorted_group_tokens_next += dtostr(token, pre_sorted_group_tokens_next, 6) + 1;
   }
   else if(flags & 2) {
     if(group_tokens_next + 31 >= group_tokens_end) resize_buffer(group_tokens, group_tokens_next, group_tokens_end, 32);
-    group_tokens_next += dtostr(token, group_tokens_next) + 1;
+    group_tokens_next += dtostr(token, group_tokens_next, 6) + 1;
   }
   if(flags & 0xFFFFFFFC) { *vi++ = token; }
   ++cfi;
 }
 
+template<typename input_base_t, typename output_base_t> void basic_summarizer_t<input_base_t, output_base_t>::process_token(int64_t token)
+{
+  //group ids keep every digit, which a double past 2^53 wouldn't
+  const uint32_t& flags = *cfi;
+  if(flags & 1) {
+    if(pre_sorted_group_tokens_next + 23 >= pre_sorted_group_tokens_end) resize_buffer(pre_sorted_group_tokens, pre_sorted_group_tokens_next, pre_sorted_group_tokens_end, 24);
+    pre_sorted_group_tokens_next += itostr(token, pre_sorted_group_tokens_next) + 1;
+  }
+  else if(flags & 2) {
+    if(group_tokens_next + 23 >= group_tokens_end) resize_buffer(group_tokens, group_tokens_next, group_tokens_end, 24);
+    group_tokens_next += itostr(token, group_tokens_next) + 1;
+  }
+  if(flags & 0xFFFFFFFC) { *vi++ = double(token); }
+  ++cfi;
+}
+
 template<typename input_base_t, typename output_base_t> void basic_summarizer_t<input_base_t, output_base_t>::process_line()
 {
   if(pre_sorted_group_tokens_next != pre_sorted_group_tokens) {
@@ -3503,7 +6540,8 @@ template<typename input_base_t, typename output_base_t> void basic_summarizer_t<
   vi = values;
   for(size_t c = 0; c < num_data_columns; ++c, ++vi) {
     data_t& d = (*i).second[c];
-    if(isnan(*vi)) ++d.missing;
+    if(nulls[c]) { ++d.missing; nulls[c] = 0; }
+    else if(isnan(*vi)) ++d.missing;
     else {
       ++d.count;
       d.sum += *vi;
@@ -3721,7 +6759,7 @@ template<typename input_base_t, typename output_base_t> void basic_base_converte
 
     if(next == token) this->output_token(token, len);
     else {
-      if(conv[column].to == 10) { this->output_token(dvalue); }
+      if(conv[column].to == 10) { if(conv[column].from == 10) this->output_token(dvalue); else this->output_token(int64_t(ivalue)); }
       else if(conv[column].to == 8) { char buf[256]; int len = sprintf(buf, "%#lo", ivalue); this->output_token(buf, len); }
       else if(conv[column].to == 16) { char buf[256]; int len = sprintf(buf, "%#lx", ivalue); this->output_token(buf, len); }
       else this->output_token(token, len);
@@ -3739,6 +6777,15 @@ template<typename input_base_t, typename output_base_t> void basic_base_converte
   ++column;
 }
 
+template<typename input_base_t, typename output_base_t> void basic_base_converter_t<input_base_t, output_base_t>::process_token(int64_t token)
+{
+  if(conv[column].to == 8) { char buf[256]; int len = sprintf(buf, "%#llo", (long long)token); this->output_token(buf, len); }
+  else if(conv[column].to == 16) { char buf[256]; int len = sprintf(buf, "%#llx", (long long)token); this->output_token(buf, len); }
+  else this->output_token(token);
+
+  ++column;
+}
+
 
 ////////////////////////////////////////////////////////////////////////////////////////////////
 // variance_analyzer
@@ -3859,7 +6906,7 @@ template<typename input_base_t, typename output_base_t> void basic_variance_anal
 
   if(*cti == 1) {
     if(group_tokens_next + 31 >= group_tokens_end) resize_buffer(group_tokens, group_tokens_next, group_tokens_end, 32);
-    group_tokens_next += dtostr(token, group_tokens_next) + 1;
+    group_tokens_next += dtostr(token, group_tokens_next, 6) + 1;
   }
   else if(*cti == 2) { *vi++ = token; }
   ++cti;
@@ -4248,7 +7295,7 @@ void basic_binary_col_adder_t<input_base_t, output_base_t, op_in1_t, op_in2_t, o
         c.c_str_val.c_str = new char[32];
         c.c_str_end = c.c_str_val.c_str + 32;
       }
-      c.c_str_val.len = dtostr(token, (char*)c.c_str_val.c_str);
+      c.c_str_val.len = dtostr(token, (char*)c.c_str_val.c_str, 6);
     }
     if(c.passthrough) this->output_token(token);
     ++ci;
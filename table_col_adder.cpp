@@ -39,7 +39,7 @@ int main(int argc, char* argv[])
       }
     }
 
-    csv_reader<substitute_col_adder<csv_writer> > r; r.set_fd(STDIN_FILENO);
+    csv_read_ahead_reader<substitute_col_adder<csv_writer> > r; r.set_fd(STDIN_FILENO);
     substitute_col_adder<csv_writer>& suba = r.get_out(); substituter sub(from, to); suba.add(col_regex, new_col_name, sub);
     csv_writer& w = suba.get_out(); w.set_fd(STDOUT_FILENO);
     r.run();
@@ -0,0 +1,80 @@
+#include <iostream>
+#include <stdexcept>
+#include "table.h"
+
+using namespace std;
+using namespace table;
+
+void print_help()
+{
+  cout << "table libtable_" << table::major_ver() << '.' << table::minor_ver() << " by Eric Gentry\n";
+  cout << "table [options] stage [stage options and columns] ...\n";
+  cout << "    -h           display this help\n";
+  cout << "    -t           run each stage on its own thread\n";
+  cout << "    --in=path    read path instead of stdin\n";
+  cout << "    --out=path   write path instead of stdout\n";
+  cout << '\n';
+  cout << "  stages, run in the order given\n";
+  cout << "    --stack      -s/-S columns to stack, -r/-R to remove, -l/-L to leave, the rest are left\n";
+  cout << "    --split      -g/-G group columns, -b/-B split by columns, -s/-S split columns, -r/-R to remove\n";
+  cout << "    --sort       -a columns to sort ascending, -d descending\n";
+  cout << "    --summarize  -g group regexes, -p pre-sorted group regexes, -e exception regexes or\n";
+  cout << "                 -missing -count -sum -min -max -avg -var -std before data regexes\n";
+  cout << "    --add        col_regex new_col_name from to, -r removes the source column of the ones after it\n";
+  cout << "    --prune      removes columns without any data\n";
+  cout << "    --thread     runs the stages after it on another thread\n";
+  cout << '\n';
+  cout << "    upper case options take regexes, options go before the first stage, @file reads more arguments from file\n";
+  cout << "    values are split at commas as in table_stack, so -s A,B is -s A B, but --in and --out paths are kept whole\n";
+}
+
+bool split_table_arg(int type, const char* key, size_t len) //always_split_arg but paths are kept whole
+{
+  if((type & st_ddash) && key && ((len == 2 && !strncmp(key, "in", 2)) || (len == 3 && !strncmp(key, "out", 3)))) return 0;
+  return always_split_arg(type, key, len);
+}
+
+
+int main(int argc, char* argv[])
+{
+  int ret_val = 0;
+
+  try {
+    pass_chain_t chain;
+    string in_path;
+    string out_path;
+    for(arg_fetcher af(argc - 1, argv + 1, split_table_arg); af.type(); af.get_next()) {
+      if(chain.add_setting(af)) continue;
+
+      const string key = af.key() ? string(af.key(), af.key_len()) : string();
+      if(af.type() & st_ddash) {
+        if(key == "in" && (af.type() & st_val)) in_path.assign(af.val(), af.val_len());
+        else if(key == "out" && (af.type() & st_val)) out_path.assign(af.val(), af.val_len());
+        else throw runtime_error("invalid double dash argument: " + key);
+      }
+      else if(af.type() & st_dash) {
+        if(key == "h") { print_help(); exit(0); }
+        else if(key == "t") chain.set_thread_stages(1);
+        else throw runtime_error("invalid dash argument: " + key);
+      }
+      else if(af.type() & st_val) throw runtime_error("argument before the first stage: " + string(af.val(), af.val_len()));
+      else throw runtime_error("invalid argument");
+    }
+
+    dynamic_csv_writer cw;
+    dynamic_csv_file_writer fw;
+    dynamic_pass_t* w = &cw;
+    if(out_path.empty()) cw.set_fd(STDOUT_FILENO);
+    else { fw.open(out_path.c_str()); w = &fw; }
+    dynamic_pass_t* head = chain.link(w);
+
+    if(in_path.empty()) { csv_read_ahead_reader<dynamic_pass_t*> r; r.set_fd(STDIN_FILENO); r.set_out(head); r.run(); }
+    else { csv_read_ahead_file_reader<dynamic_pass_t*> r; r.open(in_path.c_str()); r.set_out(head); r.run(); }
+    if(!out_path.empty()) fw.close();
+  }
+  catch(exception& e) { cerr << "Exception: " << e.what() << endl; ret_val = 1; }
+  catch(...) { cerr << "Unknown Exception" << endl; ret_val = 1; }
+
+  return ret_val;
+}
+
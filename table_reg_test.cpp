@@ -60,6 +60,15 @@ template<typename out_t> void generate_numeric_data(out_t& out, size_t num_colum
   out.process_stream();
 };
 
+string read_file(const char* path)
+{
+  string ret_val;
+  file_reader_t f; f.open(path);
+  char buf[4096];
+  for(size_t n; (n = f.read(buf, sizeof(buf))) > 0;) ret_val.append(buf, n);
+  return ret_val;
+}
+
 
 ////////////////////////////////////////////////////////////////////////////////////////////////
 // feed_data
@@ -106,12 +115,12 @@ template<typename input_base_t> class basic_simple_validater_t : public input_ba
     if(!*expected) {
       stringstream msg;
       msg << "line " << line << " is too long: ";
-      if(token) msg << " got \"" << token << '\"';
+      if(token) msg << " got \"" << string(token, len) << '\"';
       throw runtime_error(msg.str());
     }
-    else if(strcmp(token, *expected)) {
+    else if(len != strlen(*expected) || strncmp(token, *expected, len)) {
       stringstream msg;
-      if(token) msg << "got \"" << token << "\" ";
+      if(token) msg << "got \"" << string(token, len) << "\" ";
       msg << "expected \"" << *expected << "\" on [" << line << ':' << column << ']';
       throw runtime_error(msg.str());
     }
@@ -134,12 +143,12 @@ template<typename input_base_t> class basic_simple_validater_t : public input_ba
     if(!*expected) {
       stringstream msg;
       msg << "line " << line << " is too long: ";
-      if(token) msg << " got \"" << token << '\"';
+      if(token) msg << " got \"" << string(token, len) << '\"';
       throw runtime_error(msg.str());
     }
-    else if(strcmp(token, *expected)) {
+    else if(len != strlen(*expected) || strncmp(token, *expected, len)) {
       stringstream msg;
-      if(token) msg << "got \"" << token << "\" ";
+      if(token) msg << "got \"" << string(token, len) << "\" ";
       msg << "expected \"" << *expected << "\" on [" << line << ':' << column << ']';
       throw runtime_error(msg.str());
     }
@@ -575,6 +584,19 @@ const char* summarizer_expect[] = {
   0
 };
 
+const char* summarizer_double_group_expect[] = {
+  "G",        "SUM(V)", 0,
+  "0.333333", "2.5",    0,
+  0
+};
+
+const char* summarizer_null_expect[] = {
+  "G", "MISSING(V)", "COUNT(V)", 0,
+  "",  "1",          "2",        0,
+  "a", "1",          "0",        0,
+  0
+};
+
 int validate_summarizer()
 {
   int ret_val = 0;
@@ -587,6 +609,28 @@ int validate_summarizer()
     su.add_data("^C2$", SUM_MISSING | SUM_COUNT | SUM_MAX);
     su.get_out().set_expected(summarizer_expect);
     feed_data(su, summarizer_input);
+
+    //a double group key keeps the fixed 6 decimal text, it's not a value that has to read back exactly
+    summarizer<simple_validater> su2;
+    su2.add_group("^G$");
+    su2.add_data("^V$", SUM_SUM);
+    su2.get_out().set_expected(summarizer_double_group_expect);
+    su2.process_key("G", 1); su2.process_key("V", 1); su2.process_keys();
+    su2.process_token(1.0 / 3); su2.process_token(2.0); su2.process_line();
+    su2.process_token(1.0 / 3); su2.process_token(0.5); su2.process_line();
+    su2.process_stream();
+
+    //a null is missing data without going through an empty token, and a null group is the empty group
+    summarizer<simple_validater> su3;
+    su3.add_group("^G$");
+    su3.add_data("^V$", SUM_MISSING | SUM_COUNT);
+    su3.get_out().set_expected(summarizer_null_expect);
+    su3.process_key("G", 1); su3.process_key("V", 1); su3.process_keys();
+    su3.process_null(); su3.process_token(1.0); su3.process_line();
+    su3.process_token("", 0); su3.process_null(); su3.process_line();
+    su3.process_token("", 0); su3.process_token(int64_t(2)); su3.process_line();
+    su3.process_token("a", 1); su3.process_null(); su3.process_line();
+    su3.process_stream();
   }
   catch(exception& e) { cerr << __func__ << " exception: " << e.what() << endl; ret_val = 1; }
   catch(...) { cerr << __func__ << " unknown Exception" << endl; ret_val = 1; }
@@ -649,6 +693,70 @@ int validate_threader()
     threader<simple_validater> t;
     t.get_out().set_expected(threader_expect);
     generate_data(t, 3, 3);
+
+    //two small chunks wrap the ring many times
+    vector<string> tokens;
+    for(size_t line = 0; line < 2000; ++line) {
+      for(size_t column = 0; column < 5; ++column) { char buf[32]; sprintf(buf, "L%zu_C%zu", line, column); tokens.push_back(buf); }
+      tokens.push_back(string());
+    }
+    vector<const char*> expect;
+    for(vector<string>::const_iterator i = tokens.begin(); i != tokens.end(); ++i) expect.push_back((*i).empty() ? 0 : (*i).c_str());
+    expect.push_back(0);
+    threader<simple_validater> t2; t2.set_chunks(2, 64);
+    t2.get_out().set_expected(&expect[0]);
+    generate_data(t2, 5, 2000);
+  }
+  catch(exception& e) { cerr << __func__ << " exception: " << e.what() << endl; ret_val = 1; }
+  catch(...) { cerr << __func__ << " unknown Exception" << endl; ret_val = 1; }
+  
+  return ret_val;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+// parallel_map
+////////////////////////////////////////////////////////////////////////////////////////////////
+
+void add_parallel_sub(substitute_col_adder<row_buffer_t>& pass, size_t worker, void* data)
+{
+  pass.add("^L0_C0$", "L0_C1", (*static_cast<vector<substituter>*>(data))[worker]);
+}
+
+int validate_parallel_map()
+{
+  int ret_val = 0;
+
+  try {
+    //small batches spread over a few workers must come back in input order
+    vector<string> tokens;
+    for(size_t line = 0; line < 500; ++line) {
+      char buf[32];
+      sprintf(buf, "L%zu_C1", line); tokens.push_back(buf);
+      sprintf(buf, "L%zu_C0", line); tokens.push_back(buf);
+      tokens.push_back(string());
+    }
+    vector<const char*> expect;
+    for(vector<string>::const_iterator i = tokens.begin(); i != tokens.end(); ++i) expect.push_back((*i).empty() ? 0 : (*i).c_str());
+    expect.push_back(0);
+
+    //the copies set_workers makes after configure_workers get the same setup
+    parallel_map<substitute_col_adder, simple_validater> p;
+    vector<substituter> subs(3, substituter("L(\\d+)_C0", "L\\1_C1"));
+    p.set_workers(1); p.configure_workers(add_parallel_sub, &subs);
+    p.set_workers(3); p.set_batch_rows(7);
+    p.get_out().set_expected(&expect[0]);
+    generate_data(p, 1, 500);
+
+    //a partial last batch and a single worker
+    parallel_map<substitute_col_adder, simple_validater> p1;
+    p1.set_workers(1); p1.set_batch_rows(2);
+    substituter sub("L(\\d+)_C0", "L\\1_C1");
+    p1.get_worker(0).add("^L0_C0$", "L0_C1", sub);
+    p1.get_out().set_expected(uca_sub_expect);
+    generate_data(p1, 1, 3);
+    try { p1.set_workers(2); throw runtime_error("set_workers dropped a copy set up through get_worker"); }
+    catch(runtime_error& e) { if(string(e.what()) != "parallel_map: set_workers would drop the copies set up through get_worker") throw; }
   }
   catch(exception& e) { cerr << __func__ << " exception: " << e.what() << endl; ret_val = 1; }
   catch(...) { cerr << __func__ << " unknown Exception" << endl; ret_val = 1; }
@@ -754,6 +862,1378 @@ int validate_ordered_tee()
 }
 
 
+////////////////////////////////////////////////////////////////////////////////////////////////
+// csv_mmap_file_reader
+////////////////////////////////////////////////////////////////////////////////////////////////
+
+const char* csv_mmap_file_reader_expect[] = {
+  "C0", "C1", "C2",  0,
+  "0",  "1",  "2",   0,
+  "3",  "",   "5",   0,
+  "6",  "7",  "8",   0,
+  0
+};
+
+int validate_csv_mmap_file_reader()
+{
+  int ret_val = 0;
+  const char* path = "reg_test_mmap.csv";
+
+  try {
+    const char data[] = "C0,C1,C2\n\n0,1,2\n3,,5\n6,7,8";
+    { file_writer_t w; w.open(path); w.write(data, sizeof(data) - 1); w.close(); }
+
+    csv_mmap_file_reader<simple_validater> r; r.open(path);
+    r.get_out().set_expected(csv_mmap_file_reader_expect);
+    r.run();
+    r.close();
+  }
+  catch(exception& e) { cerr << __func__ << " exception: " << e.what() << endl; ret_val = 1; }
+  catch(...) { cerr << __func__ << " unknown Exception" << endl; ret_val = 1; }
+
+  unlink(path);
+  return ret_val;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+// csv_mmap_file_reader threaded
+////////////////////////////////////////////////////////////////////////////////////////////////
+
+int validate_csv_mmap_file_reader_threaded()
+{
+  int ret_val = 0;
+  const char* path = "reg_test_mmap_threaded.csv";
+  const char* out_path = "reg_test_mmap_threaded.out";
+
+  try {
+    vector<string> tokens;
+    string data;
+    for(size_t line = 0; line < 200; ++line) {
+      for(size_t column = 0; column < 3; ++column) {
+        stringstream ss; ss << 'L' << line << "_C" << column;
+        if(column) data += ',';
+        data += ss.str();
+        tokens.push_back(ss.str());
+      }
+      data += '\n';
+    }
+    { file_writer_t w; w.open(path); w.write(data.c_str(), data.size()); w.close(); }
+
+    vector<const char*> expect;
+    for(size_t i = 0; i < tokens.size(); ++i) { expect.push_back(tokens[i].c_str()); if(i % 3 == 2) expect.push_back(0); }
+    expect.push_back(0);
+
+    csv_mmap_file_reader<simple_validater> r; r.open(path); r.set_threads(3, 64);
+    r.get_out().set_expected(&expect[0]);
+    r.run();
+    r.close();
+
+    //quoted fields with newlines and "" in them land across chunk boundaries, those chunks are parsed again on the main thread
+    string quoted;
+    vector<string> quoted_tokens;
+    for(size_t line = 0; line < 200; ++line) {
+      for(size_t column = 0; column < 3; ++column) {
+        stringstream ss; ss << 'L' << line << "_C" << column;
+        string token = ss.str();
+        if(column) quoted += ',';
+        if(line % 7 == 3 && column == 1) { token += "\n\"x\"\n"; quoted += "\"" + ss.str() + "\n\"\"x\"\"\n\""; }
+        else quoted += token;
+        quoted_tokens.push_back(token);
+      }
+      quoted += '\n';
+    }
+    { file_writer_t w; w.open(path); w.write(quoted.c_str(), quoted.size()); w.close(); }
+    vector<const char*> quoted_expect;
+    for(size_t i = 0; i < quoted_tokens.size(); ++i) { quoted_expect.push_back(quoted_tokens[i].c_str()); if(i % 3 == 2) quoted_expect.push_back(0); }
+    quoted_expect.push_back(0);
+    for(size_t chunk_size = 16; chunk_size <= 256; chunk_size *= 4) {
+      csv_mmap_file_reader<simple_validater> rq; rq.open(path); rq.set_threads(3, chunk_size);
+      rq.get_out().set_expected(&quoted_expect[0]);
+      rq.run();
+      rq.close();
+    }
+    { dynamic_simple_validater v; v.set_expected(&quoted_expect[0]); csv_mmap_file_reader<dynamic_pass_t*> rq; rq.open(path); rq.set_threads(4, 64); rq.set_out(&v); rq.run(); rq.close(); }
+
+    data.insert(data.size() - 25, ",extra");
+    { file_writer_t w; w.open(path); w.write(data.c_str(), data.size()); w.close(); }
+    csv_mmap_file_reader<csv_file_writer> r2; r2.open(path); r2.set_threads(3, 64);
+    r2.get_out().open(out_path);
+    try { r2.run(); throw runtime_error("didn't catch bad column count"); }
+    catch(runtime_error& e) { if(string(e.what()) != "Line 198 had 4 tokens when num_keys is 3") throw; }
+  }
+  catch(exception& e) { cerr << __func__ << " exception: " << e.what() << endl; ret_val = 1; }
+  catch(...) { cerr << __func__ << " unknown Exception" << endl; ret_val = 1; }
+
+  unlink(path);
+  unlink(out_path);
+  return ret_val;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+// csv_read_ahead_file_reader
+////////////////////////////////////////////////////////////////////////////////////////////////
+
+int validate_csv_read_ahead_file_reader()
+{
+  int ret_val = 0;
+  const char* path = "reg_test_read_ahead.csv";
+
+  try {
+    const char data[] = "C0,C1,C2\n\n0,1,2\n3,,5\n6,7,8";
+    { file_writer_t w; w.open(path); w.write(data, sizeof(data) - 1); w.close(); }
+
+    csv_read_ahead_file_reader<simple_validater> r; r.open(path); r.set_read_ahead(3, 5);
+    r.get_out().set_expected(csv_mmap_file_reader_expect);
+    r.run();
+    r.close();
+
+    //the ring buffers are handed out in place and come back in file order
+    read_ahead_reader_t<file_reader_t> ra; ra.open(path); ra.set_read_ahead(2, 4);
+    string seen;
+    const char* b; size_t len;
+    while((b = ra.next_buffer(len))) {
+      if(len > 4) throw runtime_error("read ahead handed out more than a buffer");
+      seen.append(b, len);
+    }
+    if(seen != string(data, sizeof(data) - 1)) throw runtime_error("read ahead buffers didn't add up to the file");
+    ra.close();
+
+    //stopping with every buffer full joins the thread without cancelling it
+    { read_ahead_reader_t<file_reader_t> stopped; stopped.open(path); stopped.set_read_ahead(2, 3); stopped.next_buffer(len); }
+  }
+  catch(exception& e) { cerr << __func__ << " exception: " << e.what() << endl; ret_val = 1; }
+  catch(...) { cerr << __func__ << " unknown Exception" << endl; ret_val = 1; }
+
+  unlink(path);
+  return ret_val;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+// csv_delim_scanner
+////////////////////////////////////////////////////////////////////////////////////////////////
+
+int validate_csv_delim_scanner()
+{
+  int ret_val = 0;
+
+  try {
+    char buf[517];
+    for(size_t i = 0; i < sizeof(buf); ++i) {
+      const size_t r = (i * 2654435761u) >> 7;
+      buf[i] = (r % 11 == 0) ? ',' : (r % 37 == 0) ? '\n' : char('0' + r % 10);
+    }
+
+    for(size_t offset = 0; offset < 64; ++offset) {
+      csv_delim_scanner_t scanner;
+      const char* end = buf + sizeof(buf) - offset;
+      for(const char* p = buf + offset; p < end;) {
+        const char* e = p;
+        while(e < end && *e != '\n' && *e != ',') ++e;
+        const char* f = scanner.find(p, end);
+        if(f != e) {
+          stringstream msg; msg << "found delimiter at " << (f - buf) << " instead of " << (e - buf);
+          throw runtime_error(msg.str());
+        }
+        p = e + 1;
+      }
+    }
+
+    //with a quote the scanner stops on it as well
+    for(size_t i = 0; i < sizeof(buf); i += 29) if(buf[i] != ',' && buf[i] != '\n') buf[i] = '"';
+    for(size_t offset = 0; offset < 64; ++offset) {
+      delim_scanner_t<',', '"'> scanner;
+      const char* end = buf + sizeof(buf) - offset;
+      for(const char* p = buf + offset; p < end;) {
+        const char* e = p;
+        while(e < end && *e != '\n' && *e != ',' && *e != '"') ++e;
+        const char* f = scanner.find(p, end);
+        if(f != e) {
+          stringstream msg; msg << "found delimiter or quote at " << (f - buf) << " instead of " << (e - buf);
+          throw runtime_error(msg.str());
+        }
+        p = e + 1;
+      }
+    }
+  }
+  catch(exception& e) { cerr << __func__ << " exception: " << e.what() << endl; ret_val = 1; }
+  catch(...) { cerr << __func__ << " unknown Exception" << endl; ret_val = 1; }
+
+  return ret_val;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+// csv quoted fields
+////////////////////////////////////////////////////////////////////////////////////////////////
+
+const char* csv_quoted_expect[] = {
+  "C0",        "C,1",   "C2",    0,
+  "a \"q\" b", "x\ny",  "3",     0,
+  "",          "",      "",      0,
+  "plain",     "",      "\"",    0,
+  0
+};
+
+const char* csv_escaped_expect[] = {
+  "A",     "B",   0,
+  "x\"1",  "y\"2", 0,
+  "\"\"\"", "z\"3", 0,
+  "a\"b",  "c\"",  0,
+  0
+};
+
+int validate_csv_quoted()
+{
+  int ret_val = 0;
+  const char* path = "reg_test_quoted.csv";
+
+  try {
+    const char data[] = "\"C0\",\"C,1\",C2\n\"a \"\"q\"\" b\",\"x\ny\",3\n,\"\",\"\"\nplain,\"\",\"\"\"\"";
+    { file_writer_t w; w.open(path); w.write(data, sizeof(data) - 1); w.close(); }
+
+    { csv_file_reader<simple_validater> r; r.open(path); r.get_out().set_expected(csv_quoted_expect); r.run(); r.close(); }
+    { csv_read_ahead_file_reader<simple_validater> r; r.open(path); r.set_read_ahead(3, 5); r.get_out().set_expected(csv_quoted_expect); r.run(); r.close(); }
+    { csv_mmap_file_reader<simple_validater> r; r.open(path); r.get_out().set_expected(csv_quoted_expect); r.run(); r.close(); }
+    { csv_mmap_file_reader<simple_validater> r; r.open(path); r.set_threads(3, 8); r.get_out().set_expected(csv_quoted_expect); r.run(); r.close(); }
+
+    //row blocks hold several unescaped fields at once, each keeps its own text and the file is left as it was, a quote inside a token is text
+    const char escaped_data[] = "A,B\n\"x\"\"1\",\"y\"\"2\"\n\"\"\"\"\"\"\"\",\"z\"\"3\"\na\"b,c\"\n";
+    { file_writer_t w; w.open(path); w.write(escaped_data, sizeof(escaped_data) - 1); w.close(); }
+    { dynamic_simple_validater v; v.set_expected(csv_escaped_expect); csv_mmap_file_reader<dynamic_pass_t*> r; r.open(path); r.set_out(&v); r.run(); r.close(); }
+    { dynamic_simple_validater v; v.set_expected(csv_escaped_expect); csv_read_ahead_file_reader<dynamic_pass_t*> r; r.open(path); r.set_read_ahead(3, 5); r.set_out(&v); r.run(); r.close(); }
+    { file_reader_t f; f.open(path); char check[64]; if(f.read(check, sizeof(check)) != ssize_t(sizeof(escaped_data) - 1) || memcmp(check, escaped_data, sizeof(escaped_data) - 1)) throw runtime_error("reading unescaped into the input"); }
+
+    const char bad_data[] = "C0,C1\n0,\"1\n";
+    { file_writer_t w; w.open(path); w.write(bad_data, sizeof(bad_data) - 1); w.close(); }
+    csv_file_reader<csv_file_writer> r; r.open(path);
+    r.get_out().open("reg_test_quoted.out");
+    try { r.run(); throw runtime_error("didn't catch unterminated quote"); }
+    catch(runtime_error& e) { if(string(e.what()) != "Line 1 has an unterminated quoted field") throw; }
+  }
+  catch(exception& e) { cerr << __func__ << " exception: " << e.what() << endl; ret_val = 1; }
+  catch(...) { cerr << __func__ << " unknown Exception" << endl; ret_val = 1; }
+
+  unlink(path);
+  unlink("reg_test_quoted.out");
+  return ret_val;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+// csv reader skip columns
+////////////////////////////////////////////////////////////////////////////////////////////////
+
+const char* summarizer_skip_expect[] = {
+  "G", "SUM(V)", 0,
+  "a", "3",      0,
+  0
+};
+
+int validate_csv_skip_columns()
+{
+  int ret_val = 0;
+  const char* path = "reg_test_skip_columns.csv";
+
+  try {
+    { csv_file_writer w(path); generate_data(w, 4, 2); w.close(); }
+    csv_file_reader<stacker<simple_validater> > r; r.open(path);
+    r.get_out().set_default_action(ST_STACK);
+    r.get_out().add_action(0, "L0_C1", ST_LEAVE);
+    r.get_out().add_action(0, "L0_C3", ST_REMOVE);
+    r.get_out().get_out().set_expected(stacker_expect);
+    r.run();
+    r.close();
+
+    { csv_file_writer w(path); generate_data(w, 4, 3); w.close(); }
+    csv_mmap_file_reader<stacker<simple_validater> > r2; r2.open(path); r2.set_threads(2, 16);
+    r2.get_out().set_default_action(ST_LEAVE);
+    r2.get_out().add_action(0, "L0_C2", ST_REMOVE);
+    r2.get_out().add_action(0, "L0_C3", ST_STACK);
+    r2.get_out().get_out().set_expected(stacker_expect2);
+    r2.run();
+    r2.close();
+
+    string data;
+    bool first = 1;
+    for(const char** p = summarizer_input; *p || !first; ++p) {
+      if(!*p) { data += '\n'; first = 1; continue; }
+      if(!first) data += ',';
+      data += *p;
+      if(first) data += ",x";
+      first = 0;
+    }
+    { file_writer_t w; w.open(path); w.write(data.c_str(), data.size()); w.close(); }
+    csv_file_reader<summarizer<simple_validater> > r3; r3.open(path);
+    r3.get_out().add_group("^C0$", 1);
+    r3.get_out().add_group("^C1$");
+    r3.get_out().add_data("^C1$", SUM_COUNT);
+    r3.get_out().add_data("^C2$", SUM_MISSING | SUM_COUNT | SUM_MAX);
+    r3.get_out().get_out().set_expected(summarizer_expect);
+    r3.run();
+    r3.close();
+
+    //a threader asks the stacker behind it, and asking again doesn't renumber again
+    threader<stacker<simple_validater> > t;
+    t.get_out().set_default_action(ST_STACK);
+    t.get_out().add_action(0, "L0_C1", ST_LEAVE);
+    t.get_out().add_action(0, "L0_C3", ST_REMOVE);
+    t.get_out().get_out().set_expected(stacker_expect);
+    const char* keys[] = { "L0_C0", "L0_C1", "L0_C2", "L0_C3" };
+    for(int c = 0; c < 4; ++c) t.process_key(keys[c], 5);
+    const vector<bool>* skip = t.get_skip_columns();
+    if(!skip || t.get_skip_columns() != skip || skip->size() != 4 || (*skip)[0] || (*skip)[1] || (*skip)[2] || !(*skip)[3]) throw runtime_error("threader didn't pass on the stacker's skip columns");
+    t.process_keys();
+    t.process_token("L1_C0", 5); t.process_token("L1_C1", 5); t.process_token("L1_C2", 5); t.process_line();
+    t.process_stream();
+
+    summarizer<simple_validater> s;
+    s.add_group("^G$");
+    s.add_data("^V$", SUM_SUM);
+    s.get_out().set_expected(summarizer_skip_expect);
+    s.process_key("G", 1); s.process_key("X", 1); s.process_key("V", 1);
+    s.get_skip_columns();
+    skip = s.get_skip_columns();
+    if(!skip || skip->size() != 3 || (*skip)[0] || !(*skip)[1] || (*skip)[2]) throw runtime_error("summarizer skip columns changed when asked again");
+    s.process_keys();
+    s.process_token("a", 1); s.process_token("1", 1); s.process_line();
+    s.process_token("a", 1); s.process_token("2", 1); s.process_line();
+    s.process_stream();
+  }
+  catch(exception& e) { cerr << __func__ << " exception: " << e.what() << endl; ret_val = 1; }
+  catch(...) { cerr << __func__ << " unknown Exception" << endl; ret_val = 1; }
+
+  unlink(path);
+  return ret_val;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+// csv reader numeric inference
+////////////////////////////////////////////////////////////////////////////////////////////////
+
+const char* csv_infer_numeric_expect[] = {
+  "ID",  "N",    "S", "M",   0,
+  "007", "2.50", "a", "1e2", 0,
+  "008", "2",    "b", "2",   0,
+  "009", "3",    "4", "x",   0,
+  "010", "",     "c", "5",   0,
+  0
+};
+
+int validate_csv_infer_numeric()
+{
+  int ret_val = 0;
+  const char* path = "reg_test_infer_numeric.csv";
+
+  try {
+    const char data[] = "ID,N,S,M\n007,2.50,a,1e2\n008,2,b,2\n009,3.0,4,x\n010,,c,5.0\n";
+    { file_writer_t w; w.open(path); w.write(data, sizeof(data) - 1); w.close(); }
+
+    csv_file_reader<simple_validater> r; r.open(path); r.set_infer_numeric(2); r.add_string_column("ID");
+    r.get_out().set_expected(csv_infer_numeric_expect);
+    r.run();
+    r.close();
+
+    csv_mmap_file_reader<simple_validater> r2; r2.open(path); r2.set_threads(2, 8); r2.set_infer_numeric(2); r2.add_string_column("ID");
+    r2.get_out().set_expected(csv_infer_numeric_expect);
+    r2.run();
+    r2.close();
+  }
+  catch(exception& e) { cerr << __func__ << " exception: " << e.what() << endl; ret_val = 1; }
+  catch(...) { cerr << __func__ << " unknown Exception" << endl; ret_val = 1; }
+
+  unlink(path);
+  return ret_val;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+// delimiter policies, fixed_width_file_reader
+////////////////////////////////////////////////////////////////////////////////////////////////
+
+int validate_delim_readers()
+{
+  int ret_val = 0;
+  const char* path = "reg_test_delim.txt";
+
+  try {
+    const char tsv_data[] = "C0\tC1\tC2\n\n0\t1\t2\n3\t\t5\n6\t7\t8";
+    { file_writer_t w; w.open(path); w.write(tsv_data, sizeof(tsv_data) - 1); w.close(); }
+    { csv_file_reader<simple_validater, tab_delim_t> r; r.open(path); r.get_out().set_expected(csv_mmap_file_reader_expect); r.run(); r.close(); }
+    { csv_mmap_file_reader<simple_validater, tab_delim_t> r; r.open(path); r.set_threads(2, 8); r.get_out().set_expected(csv_mmap_file_reader_expect); r.run(); r.close(); }
+
+    const char pipe_data[] = "C0|C1|C2\n\n0|1|2\n3||5\n6|7|8";
+    { file_writer_t w; w.open(path); w.write(pipe_data, sizeof(pipe_data) - 1); w.close(); }
+    { csv_read_ahead_file_reader<simple_validater, pipe_delim_t> r; r.open(path); r.set_read_ahead(3, 5); r.get_out().set_expected(csv_mmap_file_reader_expect); r.run(); r.close(); }
+  }
+  catch(exception& e) { cerr << __func__ << " exception: " << e.what() << endl; ret_val = 1; }
+  catch(...) { cerr << __func__ << " unknown Exception" << endl; ret_val = 1; }
+
+  unlink(path);
+  return ret_val;
+}
+
+const char* fixed_width_expect[] = {
+  "A",   "B",    "C",  0,
+  "ab",  "1234", "xy", 0,
+  " c",  "5",    "",   0,
+  "zzz", "9999", "ok", 0,
+  0
+};
+
+const char* fixed_width_sum_expect[] = {
+  "SUM(V)", 0,
+  "579",    0,
+  0
+};
+
+int validate_fixed_width_file_reader()
+{
+  int ret_val = 0;
+  const char* path = "reg_test_fixed_width.txt";
+
+  try {
+    const char data[] = "ab 1234xy\n c 5     \nzzz9999ok";
+    { file_writer_t w; w.open(path); w.write(data, sizeof(data) - 1); w.close(); }
+
+    fixed_width_file_reader<simple_validater> r; r.open(path);
+    r.add_column("A", 3);
+    r.add_column("B", 4);
+    r.add_column("C", 2);
+    r.get_out().set_expected(fixed_width_expect);
+    r.run();
+    r.close();
+
+    const char bad_data[] = "ab 1234xy\n c 5    \nzzz9999ok\n";
+    { file_writer_t w; w.open(path); w.write(bad_data, sizeof(bad_data) - 1); w.close(); }
+    fixed_width_file_reader<csv_file_writer> r2; r2.open(path);
+    r2.add_column("A", 3);
+    r2.add_column("B", 4);
+    r2.add_column("C", 2);
+    r2.get_out().open("reg_test_fixed_width.out");
+    try { r2.run(); throw runtime_error("didn't catch short record"); }
+    catch(runtime_error& e) { if(string(e.what()) != "Record 1 isn't 9 bytes long") throw; }
+
+    //a numeric pass reads a field with strtod, so it must stop at the field's end rather than run on into the next one
+    const char num_data[] = "1234567\n4565678\n";
+    { file_writer_t w; w.open(path); w.write(num_data, sizeof(num_data) - 1); w.close(); }
+    fixed_width_file_reader<summarizer<simple_validater> > r3; r3.open(path);
+    r3.add_column("V", 3);
+    r3.add_column("W", 4);
+    r3.get_out().add_data("V", SUM_SUM);
+    r3.get_out().get_out().set_expected(fixed_width_sum_expect);
+    r3.run();
+    r3.close();
+  }
+  catch(exception& e) { cerr << __func__ << " exception: " << e.what() << endl; ret_val = 1; }
+  catch(...) { cerr << __func__ << " unknown Exception" << endl; ret_val = 1; }
+
+  unlink(path);
+  unlink("reg_test_fixed_width.out");
+  return ret_val;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+// csv_multi_file_reader
+////////////////////////////////////////////////////////////////////////////////////////////////
+
+const char* csv_multi_quoted_expect[] = {
+  "A", "B\nC", 0,
+  "1", "2",    0,
+  "3", "4",    0,
+  0
+};
+
+int validate_csv_multi_file_reader()
+{
+  int ret_val = 0;
+  const char* paths[] = { "reg_test_multi_a.csv", "reg_test_multi_b.csv", "reg_test_multi_c.csv", "reg_test_multi_d.csv" };
+  //later headers are compared as keys, so quoting and a CRLF line end don't matter
+  const char* data[] = { "C0,C1,C2\n0,1,2\n", "\n\"C0\",C1,C2\r\n3,,5", "", "C0,C1,\"C2\"\n6,7,8\n" };
+
+  try {
+    for(size_t i = 0; i < 4; ++i) { file_writer_t w; w.open(paths[i]); w.write(data[i], strlen(data[i])); w.close(); }
+
+    csv_multi_file_reader<simple_validater> r; r.add_glob("reg_test_multi_*.csv"); r.set_read_ahead(3, 5);
+    r.get_out().set_expected(csv_mmap_file_reader_expect);
+    r.run();
+
+    { file_writer_t w; w.open(paths[2]); w.write("C0,C1,X\n", 8); w.close(); }
+    csv_multi_file_reader<csv_file_writer> r2;
+    for(size_t i = 0; i < 4; ++i) r2.add_file(paths[i]);
+    r2.get_out().open("reg_test_multi.out");
+    try { r2.run(); throw runtime_error("didn't catch header mismatch"); }
+    catch(runtime_error& e) { if(string(e.what()) != "header of reg_test_multi_c.csv doesn't match reg_test_multi_a.csv") throw; }
+
+    //a quoted key with a newline in it is one key, not the end of the header
+    { file_writer_t w; w.open(paths[0]); w.write("A,\"B\nC\"\n1,2\n", 12); w.close(); }
+    { file_writer_t w; w.open(paths[1]); w.write("\"A\",\"B\nC\"\r\n3,4\n", 15); w.close(); }
+    csv_multi_file_reader<simple_validater> r3; r3.add_file(paths[0]); r3.add_file(paths[1]);
+    r3.get_out().set_expected(csv_multi_quoted_expect);
+    r3.run();
+  }
+  catch(exception& e) { cerr << __func__ << " exception: " << e.what() << endl; ret_val = 1; }
+  catch(...) { cerr << __func__ << " unknown Exception" << endl; ret_val = 1; }
+
+  for(size_t i = 0; i < 4; ++i) unlink(paths[i]);
+  unlink("reg_test_multi.out");
+  return ret_val;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+// dtostr
+////////////////////////////////////////////////////////////////////////////////////////////////
+
+int validate_dtostr()
+{
+  int ret_val = 0;
+
+  try {
+    const double values[] = { 0.0, -1.0, 0.1, 0.1 + 0.2, 2.5, 1e15, 4294967296.0, 123456789012345678.0, 1e21, 1e-7, 0.000001, 5e-324, 1.7976931348623157e308 };
+    const char* shortest[] = { "0", "-1", "0.1", "0.30000000000000004", "2.5", "1000000000000000", "4294967296", "123456789012345680", "1e+21", "1e-07", "0.000001", "5e-324", "1.7976931348623157e+308" };
+    const char* fixed[] = { "0", "-1", "0.1", "0.3", "2.5", "1000000000000000", "4294967296", "123456789012345680", "1e+21", "0", "0.000001", "0", "1.7976931348623157e+308" };
+    char buf[32];
+    for(size_t i = 0; i < sizeof(values) / sizeof(*values); ++i) {
+      dtostr(values[i], buf);
+      if(strcmp(buf, shortest[i])) throw runtime_error(string("shortest got ") + buf + " expected " + shortest[i]);
+      dtostr(values[i], buf, 6);
+      if(strcmp(buf, fixed[i])) throw runtime_error(string("fixed got ") + buf + " expected " + fixed[i]);
+    }
+
+    uint64_t x = 88172645463325252ULL;
+    for(size_t i = 0; i < 100000; ++i) {
+      x ^= x << 13; x ^= x >> 7; x ^= x << 17;
+      double value; memcpy(&value, &x, sizeof(value));
+      if(isnan(value) || isinf(value)) continue;
+      dtostr(value, buf);
+      if(strtod(buf, 0) != value) throw runtime_error(string("round trip failed for ") + buf);
+    }
+  }
+  catch(exception& e) { cerr << __func__ << " exception: " << e.what() << endl; ret_val = 1; }
+  catch(...) { cerr << __func__ << " unknown Exception" << endl; ret_val = 1; }
+
+  return ret_val;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+// async_csv_file_writer
+////////////////////////////////////////////////////////////////////////////////////////////////
+
+int validate_async_csv_file_writer()
+{
+  int ret_val = 0;
+
+  try {
+    {
+      async_csv_file_writer w; w.set_async(3, 7); w.open("reg_test_async.csv");
+      const char** e = csv_mmap_file_reader_expect;
+      for(; *e; ++e) w.process_key(*e, strlen(*e));
+      w.process_keys();
+      for(++e; *e; ++e) {
+        for(; *e; ++e) w.process_token(*e, strlen(*e));
+        w.process_line();
+      }
+      w.process_stream();
+      w.close();
+    }
+
+    csv_file_reader<simple_validater> r; r.open("reg_test_async.csv");
+    r.get_out().set_expected(csv_mmap_file_reader_expect);
+    r.run();
+
+    async_csv_file_writer w2; w2.set_async(2, 1); w2.open("/dev/full");
+    try { w2.process_key("x", 1); w2.process_keys(); w2.process_stream(); throw runtime_error("didn't catch write error"); }
+    catch(runtime_error& e) { if(string(e.what()) != "unable to write") throw; }
+
+    //close passes on the write error but still closes the file, so the next open gets the same fd
+    const int lowest_fd = dup(STDIN_FILENO); ::close(lowest_fd);
+    async_csv_file_writer w3; w3.set_async(2, 1024); w3.open("/dev/full");
+    w3.process_key("x", 1); w3.process_keys();
+    try { w3.close(); throw runtime_error("close didn't pass on the write error"); }
+    catch(runtime_error& e) { if(string(e.what()) != "unable to write") throw; }
+    const int next_fd = dup(STDIN_FILENO); ::close(next_fd);
+    if(next_fd != lowest_fd) throw runtime_error("close left the file open after a write error");
+  }
+  catch(exception& e) { cerr << __func__ << " exception: " << e.what() << endl; ret_val = 1; }
+  catch(...) { cerr << __func__ << " unknown Exception" << endl; ret_val = 1; }
+
+  unlink("reg_test_async.csv");
+  return ret_val;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+// binary_file_writer, binary_file_reader
+////////////////////////////////////////////////////////////////////////////////////////////////
+
+const char* binary_expect[] = {
+  "A",      "B",                   0,
+  "x\n,\"y", "0.30000000000000004", 0,
+  "",       "-1e-300",             0,
+  0
+};
+
+int validate_binary_file_reader()
+{
+  int ret_val = 0;
+  const char* path = "reg_test_binary.bin";
+
+  try {
+    binary_file_writer w; w.open(path);
+    w.process_key("A", 1); w.process_key("B", 1); w.process_keys();
+    w.process_token("x\n,\"y", 5); w.process_token(0.1 + 0.2); w.process_line();
+    w.process_token("", 0); w.process_token(-1e-300); w.process_line();
+    w.process_stream();
+    w.close();
+
+    binary_file_reader<simple_validater> r; r.open(path);
+    r.get_out().set_expected(binary_expect);
+    r.run();
+    r.close();
+
+    //csv in, binary between the passes, csv out
+    { file_writer_t w; w.open("reg_test_binary.csv"); w.write("C0,C1,C2\n0,1,2\n3,,5\n6,7,8\n", 26); w.close(); }
+    csv_file_reader<binary_file_writer> r2; r2.open("reg_test_binary.csv"); r2.set_infer_numeric(2);
+    r2.get_out().open(path);
+    r2.run();
+    r2.get_out().close();
+    binary_file_reader<simple_validater> r3; r3.open(path);
+    r3.get_out().set_expected(csv_mmap_file_reader_expect);
+    r3.run();
+    r3.close();
+
+    { file_writer_t w; w.open("reg_test_binary.csv"); char head[16]; file_reader_t f; f.open(path); f.read(head, sizeof(head)); w.write(head, sizeof(head)); w.close(); }
+    binary_file_reader<simple_validater> r4; r4.open("reg_test_binary.csv");
+    r4.get_out().set_expected(csv_mmap_file_reader_expect);
+    try { r4.run(); throw runtime_error("didn't catch truncated input"); }
+    catch(runtime_error& e) { if(string(e.what()) != "truncated binary stream") throw; }
+
+    { file_writer_t w; w.open("reg_test_binary.csv"); w.write("C0,C1\n", 6); w.close(); }
+    binary_file_reader<simple_validater> r5; r5.open("reg_test_binary.csv");
+    try { r5.run(); throw runtime_error("didn't catch bad header"); }
+    catch(runtime_error& e) { if(string(e.what()) != "not a binary table stream") throw; }
+  }
+  catch(exception& e) { cerr << __func__ << " exception: " << e.what() << endl; ret_val = 1; }
+  catch(...) { cerr << __func__ << " unknown Exception" << endl; ret_val = 1; }
+
+  unlink(path);
+  unlink("reg_test_binary.csv");
+  return ret_val;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+// columnar_file_writer, columnar_file_reader
+////////////////////////////////////////////////////////////////////////////////////////////////
+
+const char* columnar_expect[] = {
+  "id", "v",   "s",     0,
+  "0",  "0.5", "row 0", 0,
+  "1",  "",    "row 1", 0,
+  "2",  "x",   "row 2", 0,
+  "3",  "3.5", "row 3", 0,
+  "4",  "",    "row 4", 0,
+  "5",  "x",   "row 5", 0,
+  "6",  "6.5", "row 6", 0,
+  "7",  "",    "row 7", 0,
+  0
+};
+
+const char* columnar_range_expect[] = {
+  "id", "v",   "s",     0,
+  "6",  "6.5", "row 6", 0,
+  0
+};
+
+const char* columnar_text_range_expect[] = {
+  "k", "v",  0,
+  "b", "20", 0,
+  "c", "30", 0,
+  0
+};
+
+int validate_columnar_file_reader()
+{
+  int ret_val = 0;
+  const char* path = "reg_test_columnar.col";
+
+  try {
+    columnar_file_writer w; w.set_block_rows(3); w.open(path);
+    w.process_key("id", 2); w.process_key("v", 1); w.process_key("s", 1); w.process_keys();
+    for(int i = 0; i < 8; ++i) {
+      char s[8]; sprintf(s, "row %d", i);
+      w.process_token(double(i));
+      if(i % 3 == 0) w.process_token(i + 0.5); else if(i % 3 == 1) w.process_token("", 0); else w.process_token("x", 1);
+      w.process_token(s, strlen(s));
+      w.process_line();
+    }
+    w.process_stream();
+    w.close();
+
+    columnar_file_reader<simple_validater> r; r.open(path);
+    r.get_out().set_expected(columnar_expect);
+    r.run();
+    r.close();
+    if(r.get_blocks_read() != 3 || r.get_blocks_skipped()) throw runtime_error("read the wrong number of blocks");
+
+    //the blocks are rows 0-2, 3-5 and 6-7, only the last can have a v in [6, 7]
+    columnar_file_reader<simple_validater> r2; r2.open(path);
+    r2.add_range("id", 4, 6); r2.add_range("v", 6, 7);
+    r2.get_out().set_expected(columnar_range_expect);
+    r2.run();
+    r2.close();
+    if(r2.get_blocks_read() != 1 || r2.get_blocks_skipped() != 2) throw runtime_error("skipped the wrong number of blocks");
+
+    //plain csv gives the writer text, numbers in it still go in the zone maps and match the ranges
+    { const char data[] = "k,v\na,10\nb,20\nc,30\n"; file_writer_t f; f.open("reg_test_columnar.csv"); f.write(data, sizeof(data) - 1); f.close(); }
+    csv_file_reader<columnar_file_writer> r5; r5.open("reg_test_columnar.csv");
+    r5.get_out().set_block_rows(1); r5.get_out().open(path);
+    r5.run();
+    r5.get_out().close();
+    columnar_file_reader<simple_validater> r6; r6.open(path);
+    r6.add_range("v", 15, 35);
+    r6.get_out().set_expected(columnar_text_range_expect);
+    r6.run();
+    r6.close();
+    if(r6.get_blocks_read() != 2 || r6.get_blocks_skipped() != 1) throw runtime_error("skipped the wrong number of text blocks");
+
+    //csv to columnar and back, big enough for the blocks to be compressed
+    string csv = "C0,C1\n";
+    for(int i = 0; i < 1000; ++i) { char line[32]; sprintf(line, "%d,lot %d\n", i, i % 7); csv += line; }
+    { file_writer_t f; f.open("reg_test_columnar.csv"); f.write(csv.c_str(), csv.size()); f.close(); }
+    csv_file_reader<columnar_file_writer> r3; r3.open("reg_test_columnar.csv"); r3.set_infer_numeric(10);
+    r3.get_out().set_block_rows(400); r3.get_out().open(path);
+    r3.run();
+    r3.get_out().close();
+    columnar_file_reader<csv_file_writer> r4; r4.open(path);
+    r4.get_out().open("reg_test_columnar.csv");
+    r4.run();
+    r4.get_out().close();
+    string out = read_file("reg_test_columnar.csv");
+    if(out != csv) throw runtime_error("csv didn't survive the columnar round trip");
+#if defined(TABLE_ZLIB) || defined(TABLE_ZSTD)
+    struct stat st; stat(path, &st);
+    if(size_t(st.st_size) * 2 > csv.size()) throw runtime_error("columnar blocks weren't compressed");
+#endif
+  }
+  catch(exception& e) { cerr << __func__ << " exception: " << e.what() << endl; ret_val = 1; }
+  catch(...) { cerr << __func__ << " unknown Exception" << endl; ret_val = 1; }
+
+  unlink(path);
+  unlink("reg_test_columnar.csv");
+  return ret_val;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+// csv_writer quoting
+////////////////////////////////////////////////////////////////////////////////////////////////
+
+const char* csv_writer_quoting_expect[] = {
+  "a,b",                                        "C\"1\"",                                           0,
+  "plain",                                      "two\nlines",                                       0,
+  "",                                           "cr\r",                                             0,
+  "a long token without anything to quote in", "a long token with a comma far into it, here", 0,
+  0
+};
+
+int validate_csv_writer_quoting()
+{
+  int ret_val = 0;
+  const char* path = "reg_test_quoting.csv";
+
+  try {
+    csv_file_writer w; w.open(path);
+    const char** e = csv_writer_quoting_expect;
+    for(; *e; ++e) w.process_key(*e, strlen(*e));
+    w.process_keys();
+    for(++e; *e; ++e) {
+      for(; *e; ++e) w.process_token(*e, strlen(*e));
+      w.process_line();
+    }
+    w.process_stream();
+    w.close();
+
+    string out = read_file(path);
+    const string expected = "\"a,b\",\"C\"\"1\"\"\"\nplain,\"two\nlines\"\n,\"cr\r\"\n"
+      "a long token without anything to quote in,\"a long token with a comma far into it, here\"\n";
+    if(out != expected) throw runtime_error("got " + out);
+
+    csv_file_reader<simple_validater> r; r.open(path);
+    r.get_out().set_expected(csv_writer_quoting_expect);
+    r.run();
+  }
+  catch(exception& e) { cerr << __func__ << " exception: " << e.what() << endl; ret_val = 1; }
+  catch(...) { cerr << __func__ << " unknown Exception" << endl; ret_val = 1; }
+
+  unlink(path);
+  return ret_val;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+// row blocks
+////////////////////////////////////////////////////////////////////////////////////////////////
+
+class block_counter : public dynamic_pass_t { //forwards everything, blocks as blocks so the next pass's own process_block runs
+public:
+  dynamic_pass_t* out;
+  size_t blocks;
+  size_t block_lines;
+
+  block_counter() : out(0), blocks(0), block_lines(0) {}
+  void reinit(int more_passes = 0) {}
+  void reinit_state(int more_passes = 0) {}
+  void process_key(const char* token, size_t len) { out->process_key(token, len); }
+  void process_keys() { out->process_keys(); }
+  void process_token(const char* token, size_t len) { out->process_token(token, len); }
+  void process_token(double token) { out->process_token(token); }
+  void process_line() { out->process_line(); }
+  void process_block(const row_block_t& block) { ++blocks; block_lines += block.lines(); out->process_block(block); }
+  void process_stream() { out->process_stream(); }
+};
+
+int validate_row_blocks()
+{
+  int ret_val = 0;
+  const char* in_path = "reg_test_blocks_in.csv";
+  const char* out_path = "reg_test_blocks_out.csv";
+
+  try {
+    for(int pruned = 1; pruned >= 0; --pruned) {
+      string in = "A,B,C\n", expected = pruned ? "A,C\n" : in;
+      for(size_t line = 0; line < 3000; ++line) {
+        char n[32]; sprintf(n, "%zu", line);
+        const string last = line % 100 ? string(n) : "\"q," + string(n) + "\"";
+        in += "a" + string(n) + (pruned ? "," : ",b") + "," + last + "\n";
+        expected += "a" + string(n) + (pruned ? "" : ",b") + "," + last + "\n";
+      }
+      { file_writer_t f; f.open(in_path); f.write(in.c_str(), in.size()); f.close(); }
+
+      csv_file_reader<dynamic_pass_t*> r; r.open(in_path); r.set_block_rows(100);
+      //the pruner goes to passthrough part way through its first block when nothing is pruned and forwards the rest as blocks
+      block_counter c, c2, c3;
+      dynamic_output_dynamic_col_pruner p;
+      dynamic_output_dynamic_threader t; t.set_chunks(4, 256);
+      dynamic_csv_file_writer w; w.open(out_path);
+      r.set_out(&c); c.out = &p; p.set_out(&c2); c2.out = &t; t.set_out(&c3); c3.out = &w;
+      r.run();
+      w.close();
+
+      string out = read_file(out_path);
+      if(out != expected) throw runtime_error("unexpected output with " + string(pruned ? "a pruned column" : "no pruned columns"));
+      if(c.blocks < 30 || c.block_lines != 3000) throw runtime_error("csv_reader didn't output row blocks");
+      if(pruned ? c2.blocks != 0 : c2.blocks < 29 || c2.block_lines < 2900) throw runtime_error("col_pruner didn't forward row blocks in passthrough");
+      if(c3.block_lines != 3000) throw runtime_error("threader didn't output row blocks");
+    }
+  }
+  catch(exception& e) { cerr << __func__ << " exception: " << e.what() << endl; ret_val = 1; }
+  catch(...) { cerr << __func__ << " unknown Exception" << endl; ret_val = 1; }
+
+  unlink(in_path);
+  unlink(out_path);
+  return ret_val;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+// typed tokens
+////////////////////////////////////////////////////////////////////////////////////////////////
+
+class typed_recorder : public dynamic_pass_t { //logs each call with its type
+public:
+  string log;
+
+  void reinit(int more_passes = 0) { log.clear(); }
+  void reinit_state(int more_passes = 0) { log.clear(); }
+  void process_key(const char* token, size_t len) { log += "k:" + string(token, len) + ' '; }
+  void process_keys() { log += "K\n"; }
+  void process_token(const char* token, size_t len) { log += "s:" + string(token, len) + ' '; }
+  void process_token(double token) { char buf[32]; dtostr(token, buf); log += string("d:") + buf + ' '; }
+  void process_token(int64_t token) { char buf[24]; itostr(token, buf); log += string("i:") + buf + ' '; }
+  void process_null() { log += "n "; }
+  void process_line() { log += "L\n"; }
+  void process_stream() { log += "S"; }
+};
+
+template<typename pass_t> void generate_typed_data(pass_t& p)
+{
+  p.process_key("A", 1); p.process_key("B", 1); p.process_key("C", 1); p.process_keys();
+  p.process_token(int64_t(9007199254740993LL)); p.process_null(); p.process_token("x", 1); p.process_line();
+  p.process_token(int64_t(-5)); p.process_token(2.5); p.process_null(); p.process_line();
+  p.process_stream();
+}
+
+const char* typed_fallback_expect[] = {
+  "A", "B",   "C", 0,
+  "7", "",    "x", 0,
+  "-5", "2.5", "", 0,
+  0
+};
+
+int validate_typed_tokens()
+{
+  int ret_val = 0;
+
+  try {
+    const string expected = "k:A k:B k:C K\ni:9007199254740993 n s:x L\ni:-5 d:2.5 n L\nS";
+
+    //the ordered_tee replays its copy, the threader and col_pruner carry the types through their buffers
+    dynamic_ordered_tee tee;
+    dynamic_output_dynamic_threader th; typed_recorder r1; th.set_out(&r1);
+    dynamic_output_dynamic_col_pruner cp; typed_recorder r2; cp.set_out(&r2);
+    tee.add_out(th); tee.add_out(cp);
+    generate_typed_data(tee);
+    if(r1.log != expected) throw runtime_error("threader got " + r1.log);
+    if(r2.log != expected) throw runtime_error("col_pruner got " + r2.log);
+
+    dynamic_output_row_joiner j; typed_recorder r3; j.set_out(&r3);
+    j.process_key("A", 1); j.process_keys(); j.process_token(int64_t(-9223372036854775807LL - 1)); j.process_line(); j.process_stream();
+    j.process_key("B", 1); j.process_keys(); j.process_null(); j.process_line(); j.process_stream();
+    j.process();
+    if(r3.log != "k:A k:B K\ni:-9223372036854775808 n L\nS") throw runtime_error("row_joiner got " + r3.log);
+
+    //strings starting with the bytes the buffers tag values with come back as strings
+    const string tagged_expect = "k:\x01" "A k:\x0f K\ns:\x07" "x s:\x03 L\ns:\x04 s:\x08\x02 L\nS";
+    dynamic_ordered_tee tee2;
+    dynamic_output_dynamic_threader th2; typed_recorder r4; th2.set_out(&r4);
+    dynamic_output_dynamic_col_pruner cp2; typed_recorder r5; cp2.set_out(&r5);
+    tee2.add_out(th2); tee2.add_out(cp2);
+    tee2.process_key("\x01" "A", 2); tee2.process_key("\x0f", 1); tee2.process_keys();
+    tee2.process_token("\x07" "x", 2); tee2.process_token("\x03", 1); tee2.process_line();
+    tee2.process_token("\x04", 1); tee2.process_token("\x08\x02", 2); tee2.process_line();
+    tee2.process_stream();
+    if(r4.log != tagged_expect) throw runtime_error("threader got " + r4.log);
+    if(r5.log != tagged_expect) throw runtime_error("col_pruner got " + r5.log);
+
+    dynamic_output_row_joiner j2; typed_recorder r6; j2.set_out(&r6);
+    j2.process_key("A", 1); j2.process_keys(); j2.process_token("\x01", 1); j2.process_line(); j2.process_stream();
+    j2.process_key("B", 1); j2.process_keys(); j2.process_token("\x04" "x", 2); j2.process_line(); j2.process_stream();
+    j2.process();
+    if(r6.log != "k:A k:B K\ns:\x01 s:\x04" "x L\nS") throw runtime_error("row_joiner got " + r6.log);
+
+    //a pass without the typed calls gets a double and an empty token
+    threader<simple_validater> sv;
+    sv.get_out().set_expected(typed_fallback_expect);
+    sv.process_key("A", 1); sv.process_key("B", 1); sv.process_key("C", 1); sv.process_keys();
+    sv.process_token(int64_t(7)); sv.process_null(); sv.process_token("x", 1); sv.process_line();
+    sv.process_token(int64_t(-5)); sv.process_token(2.5); sv.process_null(); sv.process_line();
+    sv.process_stream();
+
+    const char* path = "reg_test_typed.csv";
+    { dynamic_csv_file_writer w; w.open(path); generate_typed_data(w); w.close(); }
+    string out = read_file(path);
+    unlink(path);
+    if(out != "A,B,C\n9007199254740993,,x\n-5,2.5,\n") throw runtime_error("csv_writer wrote " + out);
+  }
+  catch(exception& e) { cerr << __func__ << " exception: " << e.what() << endl; ret_val = 1; }
+  catch(...) { cerr << __func__ << " unknown Exception" << endl; ret_val = 1; }
+
+  return ret_val;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+// pass_chain
+////////////////////////////////////////////////////////////////////////////////////////////////
+
+const char* pass_chain_sort_add_prune[] = { "--sort", "-d", "A", "--add", "^B$", "B2", "(.)", "<\\1>", "--prune" };
+
+const char* pass_chain_sort_add_prune_expect[] = {
+  "A", "B2",  "B",  0,
+  "3", "<q>", "q2", 0,
+  "2", "<r>", "r3", 0,
+  "1", "<p>", "p1", 0,
+  0
+};
+
+const char* pass_chain_split[] = { "--split", "-g", "A", "-b", "B", "-s", "C" };
+
+const char* pass_chain_split_expect[] = {
+  "A", "C x", "C y", 0,
+  "1", "5",   "",    0,
+  "2", "",    "6",   0,
+  0
+};
+
+template<size_t n> void run_pass_chain(const char* (&args)[n], bool thread_stages, const char* data, const char** expected)
+{
+  const char* path = "reg_test_chain.csv";
+  { file_writer_t w; w.open(path); w.write(data, strlen(data)); w.close(); }
+
+  pass_chain_t chain;
+  chain.set_thread_stages(thread_stages);
+  for(arg_fetcher af(n, args); af.type(); af.get_next())
+    if(!chain.add_setting(af)) throw runtime_error("pass_chain didn't take an argument");
+  dynamic_simple_validater v; v.set_expected(expected);
+  csv_read_ahead_file_reader<dynamic_pass_t*> r; r.open(path); r.set_out(chain.link(&v));
+  r.run();
+  unlink(path);
+}
+
+int validate_pass_chain()
+{
+  int ret_val = 0;
+
+  try {
+    //the reader hands the first stage row blocks, the stages after it run on threaders
+    run_pass_chain(pass_chain_sort_add_prune, 1, "A,B,C\n1,p1,\n3,q2,\n2,r3,\n", pass_chain_sort_add_prune_expect);
+    run_pass_chain(pass_chain_split, 0, "A,B,C\n1,x,5\n2,y,6\n", pass_chain_split_expect);
+
+    { pass_chain_t chain; arg_fetcher af("A"); if(chain.add_setting(af)) throw runtime_error("pass_chain took a value before a stage"); }
+
+    bool threw = 0;
+    try { const char* args[] = { "--summarize", "A" }; pass_chain_t chain; for(arg_fetcher af(2, args); af.type(); af.get_next()) chain.add_setting(af); }
+    catch(runtime_error&) { threw = 1; }
+    if(!threw) throw runtime_error("pass_chain took summarize data without a statistic");
+
+    threw = 0;
+    try {
+      const char* args[] = { "--add", "^B$", "B2" };
+      pass_chain_t chain; for(arg_fetcher af(3, args); af.type(); af.get_next()) chain.add_setting(af);
+      dynamic_simple_validater v; chain.link(&v);
+    }
+    catch(runtime_error&) { threw = 1; }
+    if(!threw) throw runtime_error("pass_chain linked an incomplete add");
+  }
+  catch(exception& e) { cerr << __func__ << " exception: " << e.what() << endl; ret_val = 1; }
+  catch(...) { cerr << __func__ << " unknown Exception" << endl; ret_val = 1; }
+
+  return ret_val;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+// partitioned_csv_file_writer
+////////////////////////////////////////////////////////////////////////////////////////////////
+
+//every partition repeats the header, the lines with one key all go to one partition and none go missing
+void check_partitions(const char* data, size_t key_column, size_t keys)
+{
+  map<string, int> key_partition;
+  size_t lines = 0;
+  for(int p = 0; p < 3; ++p) {
+    stringstream part_path; part_path << "reg_test_part_" << p << ".csv";
+    string out = read_file(part_path.str().c_str());
+    if(out.compare(0, 12, "LOT,WAFER,V\n")) throw runtime_error(part_path.str() + " is missing the header");
+    for(size_t b = 12, e; b < out.size(); b = e + 1) {
+      e = out.find('\n', b);
+      size_t kb = b;
+      for(size_t c = 0; c < key_column; ++c) kb = out.find(',', kb) + 1;
+      const string key = out.substr(kb, out.find(',', kb) - kb);
+      if(key_partition.count(key) && key_partition[key] != p) throw runtime_error("key " + key + " is in more than one partition");
+      key_partition[key] = p;
+      if(string(data).find(out.substr(b, e + 1 - b)) == string::npos) throw runtime_error("unexpected line " + out.substr(b, e - b));
+      ++lines;
+    }
+  }
+  if(lines != 8 || key_partition.size() != keys) throw runtime_error("lines went missing");
+}
+
+int validate_partitioned_csv_file_writer()
+{
+  int ret_val = 0;
+  const char* path = "reg_test_part.csv";
+
+  try {
+    const char data[] = "LOT,WAFER,V\nA,1,0.5\nB,1,1\nA,2,1.5\nC,1,2\nB,2,2.5\nA,3,3\nD,1,3.5\nC,2,4\n";
+    { file_writer_t w; w.open(path); w.write(data, sizeof(data) - 1); w.close(); }
+
+    csv_file_reader<partitioned_csv_file_writer> r; r.open(path); r.set_infer_numeric(4);
+    r.get_out().add_key("LOT"); r.get_out().open("reg_test_part_", 3);
+    r.run();
+    r.get_out().close();
+    check_partitions(data, 0, 4);
+
+    //LOT comes before the key column, so it's held until WAFER picks the partition
+    csv_file_reader<partitioned_async_csv_file_writer> r2; r2.open(path); r2.set_infer_numeric(4);
+    r2.get_out().add_key("WAFER"); r2.get_out().open("reg_test_part_", 3);
+    r2.run();
+    r2.get_out().close();
+    check_partitions(data, 1, 3);
+  }
+  catch(exception& e) { cerr << __func__ << " exception: " << e.what() << endl; ret_val = 1; }
+  catch(...) { cerr << __func__ << " unknown Exception" << endl; ret_val = 1; }
+
+  unlink(path);
+  for(int p = 0; p < 3; ++p) { stringstream part_path; part_path << "reg_test_part_" << p << ".csv"; unlink(part_path.str().c_str()); }
+  return ret_val;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+// jsonl_file_writer, arrow_file_writer
+////////////////////////////////////////////////////////////////////////////////////////////////
+
+int validate_jsonl_arrow_writers()
+{
+  int ret_val = 0;
+  const char* path = "reg_test_jsonl.out";
+
+  try {
+    jsonl_file_writer j; j.open(path);
+    j.process_key("id", 2); j.process_key("na\"me", 5); j.process_keys();
+    const char* value = "a long \"quoted\" value with a\\back slash,\ttab and\nnewline\x01";
+    j.process_token(0.1 + 0.2); j.process_token(value, strlen(value)); j.process_line();
+    j.process_token(0.0 / 0.0); j.process_token("", 0); j.process_line();
+    j.process_stream();
+    j.close();
+
+    string out = read_file(path);
+    const string expected = "{\"id\":0.30000000000000004,\"na\\\"me\":\"a long \\\"quoted\\\" value with a\\\\back slash,\\ttab and\\nnewline\\u0001\"}\n"
+      "{\"id\":null,\"na\\\"me\":\"\"}\n";
+    if(out != expected) throw runtime_error("jsonl got " + out);
+
+    //a null from an inferred numeric column is JSON null rather than an empty string
+    jsonl_file_writer j2; j2.open(path);
+    j2.process_key("a", 1); j2.process_key("b", 1); j2.process_keys();
+    j2.process_null(); j2.process_token(int64_t(9007199254740993LL)); j2.process_line();
+    j2.process_stream();
+    j2.close();
+    out = read_file(path);
+    if(out != "{\"a\":null,\"b\":9007199254740993}\n") throw runtime_error("jsonl got " + out);
+
+    //the schema goes out after the first batch, id is float64 and name utf8, the doubles are stored as their raw bytes
+    arrow_file_writer a; a.set_batch_rows(2); a.open(path);
+    a.process_key("id", 2); a.process_key("name", 4); a.process_keys();
+    for(int i = 0; i < 3; ++i) {
+      if(i == 1) a.process_token("", 0); else a.process_token(i + 0.1 + 0.2);
+      a.process_token(i == 1 ? "1" : "x", 1);
+      a.process_line();
+    }
+    a.process_stream();
+    a.close();
+
+    out = read_file(path);
+    if(out.compare(0, 4, "\xff\xff\xff\xff") || out.size() % 8 || out.compare(out.size() - 8, 8, string("\xff\xff\xff\xff\0\0\0\0", 8))) throw runtime_error("arrow stream isn't framed");
+    const double raw = 2 + 0.1 + 0.2;
+    if(out.find(string(reinterpret_cast<const char*>(&raw), sizeof(raw))) == string::npos) throw runtime_error("arrow stream doesn't hold the raw double");
+    int32_t schema_len; memcpy(&schema_len, &out[4], sizeof(schema_len));
+    if(out.substr(8, schema_len).find("name") == string::npos) throw runtime_error("arrow schema is missing a field");
+
+    //text that isn't a number after the first batch is a null in a float64 column, numeric text is still stored
+    arrow_file_writer a2; a2.set_batch_rows(1); a2.open(path);
+    a2.process_key("id", 2); a2.process_keys();
+    a2.process_token(1.0); a2.process_line();
+    a2.process_token("not a number", 12); a2.process_line();
+    a2.process_token("2.5", 3); a2.process_line();
+    a2.process_stream();
+    a2.close();
+    out = read_file(path);
+    const double parsed = 2.5;
+    if(out.find("not a number") != string::npos) throw runtime_error("arrow stream holds text in a float64 column");
+    if(out.find(string(reinterpret_cast<const char*>(&parsed), sizeof(parsed))) == string::npos) throw runtime_error("arrow stream doesn't hold the parsed double");
+
+    //a column that is empty for the whole first batch is utf8, so text after it doesn't stop the write
+    arrow_file_writer a3; a3.set_batch_rows(2); a3.open(path);
+    a3.process_key("note", 4); a3.process_keys();
+    a3.process_token("", 0); a3.process_line();
+    a3.process_token("", 0); a3.process_line();
+    a3.process_token("late text", 9); a3.process_line();
+    a3.process_token(3.5); a3.process_line();
+    a3.process_stream();
+    a3.close();
+    out = read_file(path);
+    if(out.find("late text3.5") == string::npos) throw runtime_error("arrow stream is missing the sparse column's text");
+
+    //a typed null is a null in a utf8 column too, where an empty token is an empty string
+    arrow_file_writer a4; a4.set_batch_rows(4); a4.open(path);
+    a4.process_key("note", 4); a4.process_keys();
+    a4.process_token("x", 1); a4.process_line();
+    a4.process_null(); a4.process_line();
+    a4.process_token("", 0); a4.process_line();
+    a4.process_token("y", 1); a4.process_line();
+    a4.process_stream();
+    a4.close();
+    out = read_file(path);
+    const int64_t node[2] = { 4, 1 };
+    const int32_t offsets[5] = { 0, 1, 1, 1, 2 };
+    if(out.find(string(reinterpret_cast<const char*>(node), sizeof(node))) == string::npos) throw runtime_error("arrow stream doesn't count the null");
+    if(out.find(string("\x0d\0\0\0\0\0\0\0", 8) + string(reinterpret_cast<const char*>(offsets), sizeof(offsets))) == string::npos) throw runtime_error("arrow stream has the wrong validity or offsets");
+  }
+  catch(exception& e) { cerr << __func__ << " exception: " << e.what() << endl; ret_val = 1; }
+  catch(...) { cerr << __func__ << " unknown Exception" << endl; ret_val = 1; }
+
+  unlink(path);
+  return ret_val;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+// file writer options
+////////////////////////////////////////////////////////////////////////////////////////////////
+
+int validate_file_writer_options()
+{
+  int ret_val = 0;
+  const char* path = "reg_test_writer_options.csv";
+
+  try {
+    //a token several times the buffer goes straight through, the preallocated space doesn't show in the size
+    const string big(1000, 'x');
+    csv_file_writer w; w.set_buffer_size(128); w.set_size_hint(1024 * 1024); w.set_sync(FS_PERIODIC, 300); w.open(path);
+    w.process_key("C0", 2); w.process_key("C1", 2); w.process_keys();
+    string expected = "C0,C1\n";
+    for(int i = 0; i < 20; ++i) {
+      char token[16]; sprintf(token, "%d", i);
+      w.process_token(token, strlen(token)); w.process_token(i == 7 ? big.c_str() : "y", i == 7 ? big.size() : 1); w.process_line();
+      expected += string(token) + ',' + (i == 7 ? big : string("y")) + '\n';
+    }
+    w.process_stream();
+    w.close();
+
+    string out = read_file(path);
+    if(out != expected) throw runtime_error("writer options changed the output");
+    struct stat st; stat(path, &st);
+    if(size_t(st.st_size) != expected.size()) throw runtime_error("preallocated space changed the file size");
+
+#ifdef __linux__
+    //a hint that a device can't take is still used for the next file
+    const int probe = open(path, O_WRONLY | O_TRUNC);
+    const bool can_reserve = probe >= 0 && !fallocate(probe, FALLOC_FL_KEEP_SIZE, 0, 1024 * 1024);
+    if(probe >= 0) close(probe);
+    file_writer_t f; f.set_size_hint(1024 * 1024);
+    f.open("/dev/full"); f.close();
+    f.open(path); f.write("x", 1); f.close();
+    stat(path, &st);
+    if(st.st_size != 1) throw runtime_error("preallocated space changed the file size");
+    if(can_reserve && st.st_blocks * 512 < 1024 * 1024) throw runtime_error("the size hint was dropped after a device refused it");
+#endif
+  }
+  catch(exception& e) { cerr << __func__ << " exception: " << e.what() << endl; ret_val = 1; }
+  catch(...) { cerr << __func__ << " unknown Exception" << endl; ret_val = 1; }
+
+  unlink(path);
+  return ret_val;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+// tabular_file_writer
+////////////////////////////////////////////////////////////////////////////////////////////////
+
+int validate_tabular_file_writer()
+{
+  int ret_val = 0;
+  const char* path = "reg_test_tabular.txt";
+
+  try {
+    //two lines are sampled, after that wider cells widen their column or are cut to it
+    const char* tokens[] = { "a", "bb", "ccc", "d", "eeeee", "ffffff", "g", "h" };
+    for(int truncate = 0; truncate < 2; ++truncate) {
+      tabular_file_writer w; w.set_sample_lines(2); w.set_truncate(truncate); w.open(path);
+      w.process_key("K0", 2); w.process_key("K1", 2); w.process_keys();
+      for(int i = 0; i < 8; i += 2) { w.process_token(tokens[i], strlen(tokens[i])); w.process_token(tokens[i + 1], strlen(tokens[i + 1])); w.process_line(); }
+      w.process_stream();
+      w.close();
+
+      string out = read_file(path);
+      const string expected = string("c0=K0\nc1=K1\n\n  c0 c1\n   a bb\n ccc  d\n") + (truncate ? " eee ff\n   g  h\n" : " eeeee ffffff\n     g      h\n");
+      if(out != expected) throw runtime_error("got " + out);
+    }
+  }
+  catch(exception& e) { cerr << __func__ << " exception: " << e.what() << endl; ret_val = 1; }
+  catch(...) { cerr << __func__ << " unknown Exception" << endl; ret_val = 1; }
+
+  unlink(path);
+  return ret_val;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+// csv_gzip_file_reader, csv_zstd_file_reader
+////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifdef TABLE_ZLIB
+int validate_csv_gzip_file_reader()
+{
+  int ret_val = 0;
+  const char* path = "reg_test_gzip.csv.gz";
+
+  try {
+    const char data[] = "C0,C1,C2\n\n0,1,2\n3,,5\n6,7,8";
+    gzFile f = gzopen(path, "wb");
+    if(!f) throw runtime_error("can't open gzip file");
+    gzwrite(f, data, 12);
+    gzclose(f);
+    f = gzopen(path, "ab"); //a second gzip member
+    if(!f) throw runtime_error("can't open gzip file");
+    gzwrite(f, data + 12, sizeof(data) - 13);
+    gzclose(f);
+
+    csv_gzip_file_reader<simple_validater> r; r.open(path); r.set_read_ahead(3, 5);
+    r.get_out().set_expected(csv_mmap_file_reader_expect);
+    r.run();
+    r.close();
+
+    { file_writer_t w; w.open("reg_test_gzip.csv"); w.write(data, sizeof(data) - 1); w.close(); }
+    csv_file_reader<csv_gzip_file_writer> r2; r2.open("reg_test_gzip.csv");
+    r2.get_out().set_level(9); r2.get_out().set_async(2, 3); r2.get_out().open(path);
+    r2.run();
+    r2.get_out().close();
+    csv_gzip_file_reader<simple_validater> r3; r3.open(path);
+    r3.get_out().set_expected(csv_mmap_file_reader_expect);
+    r3.run();
+  }
+  catch(exception& e) { cerr << __func__ << " exception: " << e.what() << endl; ret_val = 1; }
+  catch(...) { cerr << __func__ << " unknown Exception" << endl; ret_val = 1; }
+
+  unlink(path);
+  unlink("reg_test_gzip.csv");
+  return ret_val;
+}
+#endif
+
+#ifdef TABLE_ZSTD
+int validate_csv_zstd_file_reader()
+{
+  int ret_val = 0;
+  const char* path = "reg_test_zstd.csv.zst";
+
+  try {
+    const char data[] = "C0,C1,C2\n\n0,1,2\n3,,5\n6,7,8";
+    vector<char> compressed(ZSTD_compressBound(sizeof(data)));
+    const size_t len = ZSTD_compress(&compressed[0], compressed.size(), data, sizeof(data) - 1, 3);
+    if(ZSTD_isError(len)) throw runtime_error("can't compress");
+    { file_writer_t w; w.open(path); w.write(&compressed[0], len); w.close(); }
+
+    csv_zstd_file_reader<simple_validater> r; r.open(path); r.set_read_ahead(3, 5);
+    r.get_out().set_expected(csv_mmap_file_reader_expect);
+    r.run();
+    r.close();
+
+    { file_writer_t w; w.open(path); w.write(&compressed[0], len - 4); w.close(); }
+    csv_zstd_file_reader<csv_file_writer> r2; r2.open(path);
+    r2.get_out().open("reg_test_zstd.out");
+    try { r2.run(); throw runtime_error("didn't catch truncated input"); }
+    catch(runtime_error& e) { if(string(e.what()) != "couldn't decompress: truncated input") throw; }
+
+    { file_writer_t w; w.open("reg_test_zstd.csv"); w.write(data, sizeof(data) - 1); w.close(); }
+    csv_file_reader<csv_zstd_file_writer> r3; r3.open("reg_test_zstd.csv");
+    r3.get_out().set_level(19); r3.get_out().set_async(2, 3); r3.get_out().open(path);
+    r3.run();
+    r3.get_out().close();
+    csv_zstd_file_reader<simple_validater> r4; r4.open(path);
+    r4.get_out().set_expected(csv_mmap_file_reader_expect);
+    r4.run();
+  }
+  catch(exception& e) { cerr << __func__ << " exception: " << e.what() << endl; ret_val = 1; }
+  catch(...) { cerr << __func__ << " unknown Exception" << endl; ret_val = 1; }
+
+  unlink(path);
+  unlink("reg_test_zstd.out");
+  unlink("reg_test_zstd.csv");
+  return ret_val;
+}
+#endif
+
+
 ////////////////////////////////////////////////////////////////////////////////////////////////
 // main
 ////////////////////////////////////////////////////////////////////////////////////////////////
@@ -768,8 +2248,37 @@ int main(int argc, char * argv[])
   validate_summarizer();
   validate_range_stacker();
   validate_threader();
+  validate_parallel_map();
   validate_subset_tee();
   validate_ordered_tee();
+  validate_csv_mmap_file_reader();
+  validate_csv_mmap_file_reader_threaded();
+  validate_csv_read_ahead_file_reader();
+  validate_csv_delim_scanner();
+  validate_csv_quoted();
+  validate_csv_skip_columns();
+  validate_csv_infer_numeric();
+  validate_delim_readers();
+  validate_fixed_width_file_reader();
+  validate_csv_multi_file_reader();
+  validate_dtostr();
+  validate_async_csv_file_writer();
+  validate_binary_file_reader();
+  validate_columnar_file_reader();
+  validate_csv_writer_quoting();
+  validate_row_blocks();
+  validate_typed_tokens();
+  validate_pass_chain();
+  validate_partitioned_csv_file_writer();
+  validate_jsonl_arrow_writers();
+  validate_file_writer_options();
+  validate_tabular_file_writer();
+#ifdef TABLE_ZLIB
+  validate_csv_gzip_file_reader();
+#endif
+#ifdef TABLE_ZSTD
+  validate_csv_zstd_file_reader();
+#endif
 
   return ret_val;
 }
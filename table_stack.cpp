@@ -26,7 +26,7 @@ int main(int argc, char* argv[])
   int ret_val = 0;
 
   try {
-    csv_reader<stacker<csv_writer> > r; r.set_fd(STDIN_FILENO);
+    csv_read_ahead_reader<stacker<csv_writer> > r; r.set_fd(STDIN_FILENO);
     stacker<csv_writer>& s = r.get_out(); s.set_default_action(ST_LEAVE);
     csv_writer& w = s.get_out(); w.set_fd(STDOUT_FILENO);
 